@@ -0,0 +1,63 @@
+// Measures the acquire throughput of frame sources, e.g. to compare MIT-SHM and XGetImage on a deployment.
+// X sources run against any X server, e.g.: xvfb-run -s "-screen 0 1920x1080x24" ./glwarp-bench-capture 500
+// Usage: glwarp-bench-capture [frames] [source ...] [-file <frame file>]
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../inc/frame_source.h"
+
+static double benchmark(FrameSource *source, int frames)
+{
+    SourceFrame frame;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        if (source->acquire(&frame) != FrameSource::ACQUIRED) {
+            std::cout << "acquire failed at frame " << i << std::endl;
+            return -1.0;
+        }
+        source->release();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    FrameSourceSettings settings;
+    settings.x = 0;
+    settings.y = 0;
+    settings.width = 1920;
+    settings.height = 1080;
+    // no damage tracking, every frame is read completely
+    settings.damage_threshold = 0.0f;
+    // replay as fast as the file can be read
+    settings.realtime = false;
+
+    std::vector<std::string> sources;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-file" && i + 1 < argc)
+            settings.path = argv[++i];
+        else
+            sources.push_back(arg);
+    }
+    if (sources.empty())
+        sources = {"shm", "x11", "synthetic"};
+
+    for (const std::string &type : sources) {
+        FrameSource *source = FrameSource::create(type, settings);
+        if (source && source->open()) {
+            double ms = benchmark(source, frames);
+            std::cout << type << ": " << source->width() << "x" << source->height() << " " << ms << " ms/frame"
+                      << std::endl;
+            source->close();
+        }
+        delete source;
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Compares WarpIndex lookups with a scan over all triangles on meshes refined from the default mesh.
+// Usage: glwarp-bench-index [queries] [-config <file>] [-mesh <file>] [-texcoords <file>] [-size <w>x<h>]
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../inc/file_io.h"
+#include "../inc/input_parser.h"
+#include "../inc/mesh_builder.h"
+#include "../inc/thread_pool.h"
+#include "../inc/view_transform.h"
+#include "../inc/warp_index.h"
+
+// the lookup the index replaces: every triangle of the mesh is projected and tested for every point
+static bool scanTriangles(const WarpMeshData &mesh, const glm::mat4 &mvp, int width, int height, float x, float y,
+                          glm::vec2 *uv)
+{
+    float nearest = 1.0f;
+    bool found = false;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        glm::vec3 p[3];
+        float inverse_w[3];
+        bool visible = true;
+        for (int k = 0; k < 3; ++k) {
+            const WarpVertex &vertex = mesh.vertices[mesh.indices[i + k]];
+            glm::vec4 clip = mvp * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f);
+            visible = visible && clip.w > 0.0f;
+            inverse_w[k] = 1.0f / clip.w;
+            p[k] = glm::vec3((clip.x * inverse_w[k] * 0.5f + 0.5f) * (float) width,
+                             (0.5f - clip.y * inverse_w[k] * 0.5f) * (float) height,
+                             clip.z * inverse_w[k] * 0.5f + 0.5f);
+        }
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+        if (!visible || area == 0.0f)
+            continue;
+
+        float b[3];
+        for (int k = 0; k < 3; ++k) {
+            const glm::vec3 &a = p[(k + 1) % 3];
+            const glm::vec3 &c = p[(k + 2) % 3];
+            b[k] = ((c.x - a.x) * (y - a.y) - (c.y - a.y) * (x - a.x)) / area;
+        }
+        if (b[0] < 0.0f || b[1] < 0.0f || b[2] < 0.0f)
+            continue;
+
+        float z = b[0] * p[0].z + b[1] * p[1].z + b[2] * p[2].z;
+        if (z < 0.0f || z >= nearest)
+            continue;
+        nearest = z;
+
+        float w = 0.0f, u = 0.0f, t = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            const WarpVertex &vertex = mesh.vertices[mesh.indices[i + k]];
+            w += b[k] * inverse_w[k];
+            u += b[k] * vertex.u * inverse_w[k];
+            t += b[k] * (1.0f - vertex.v) * inverse_w[k];
+        }
+        *uv = glm::vec2(u / w, t / w);
+        found = true;
+    }
+    return found;
+}
+
+// samples the default mesh bilinearly between its rings and points, so the refined mesh keeps its shape
+static glm::vec3 sample(const std::vector<glm::vec3> &points, const MeshLayout &layout, float ring, float point)
+{
+    auto point_at = [&](int r, int p) {
+        p %= layout.points_per_ring;
+        return r == 0 ? points[0] : points[1 + (size_t) (r - 1) * layout.points_per_ring + p];
+    };
+    auto r0 = std::min((int) ring, layout.rings - 1);
+    auto p0 = (int) point;
+    float fr = ring - (float) r0;
+    float fp = point - (float) p0;
+    glm::vec3 inner = point_at(r0, p0) * (1.0f - fp) + point_at(r0, p0 + 1) * fp;
+    glm::vec3 outer = point_at(r0 + 1, p0) * (1.0f - fp) + point_at(r0 + 1, p0 + 1) * fp;
+    return inner * (1.0f - fr) + outer * fr;
+}
+
+int main(int argc, char *argv[])
+{
+    InputParser input(argc, argv);
+    int queries = argc > 1 && argv[1][0] != '-' ? std::atoi(argv[1]) : 100000;
+    std::string config_path = input.cmdOptionExists("-config") ? input.getCmdOption("-config") : "default/model.json";
+    std::string mesh_path = input.cmdOptionExists("-mesh") ? input.getCmdOption("-mesh") : "default/default.mesh";
+    std::string tex_path = input.cmdOptionExists("-texcoords") ? input.getCmdOption("-texcoords")
+                                                                : "default/default.tex";
+    int width = 1920, height = 1080;
+    if (input.cmdOptionExists("-size") &&
+        std::sscanf(input.getCmdOption("-size").c_str(), "%dx%d", &width, &height) != 2) {
+        std::cout << "Info: Unknown size '" << input.getCmdOption("-size") << "'. Using default!" << std::endl;
+        width = 1920;
+        height = 1080;
+    }
+
+    std::vector<glm::vec3> points, uvs;
+    MeshLayout layout, tex_layout;
+    if (!FileIO::loadMesh(mesh_path.c_str(), &points, &layout) ||
+        !FileIO::loadMesh(tex_path.c_str(), &uvs, &tex_layout) || points.size() != uvs.size()) {
+        std::cout << "Could not load '" << mesh_path << "' and '" << tex_path << "'" << std::endl;
+        return 1;
+    }
+
+    std::ifstream config_file(config_path);
+    std::stringstream config_text;
+    config_text << config_file.rdbuf();
+    std::string error;
+    json11::Json config = json11::Json::parse(config_text.str(), error);
+    glm::mat4 mvp = ViewTransform::mvp(ViewTransform::modelPosition(config), glm::vec3(0.0f));
+
+    // the same points for every mesh, spread over the whole output
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> x_distribution(0.0f, (float) width);
+    std::uniform_real_distribution<float> y_distribution(0.0f, (float) height);
+    std::vector<glm::vec2> query_points((size_t) queries);
+    for (glm::vec2 &point : query_points)
+        point = glm::vec2(x_distribution(random), y_distribution(random));
+    std::vector<glm::vec2> found((size_t) queries);
+
+    ThreadPool pool;
+    std::cout << "output " << width << "x" << height << ", " << queries << " queries" << std::endl;
+    std::cout << "triangles  build ms  scan queries/s  index queries/s  " << pool.threadCount()
+              << " threads queries/s  inside  mismatches" << std::endl;
+    for (int scale = 1; scale <= 64; scale *= 4) {
+        int rings = layout.rings * scale;
+        int points_per_ring = layout.points_per_ring * scale;
+        MeshBuilder builder(rings, points_per_ring);
+        std::vector<glm::vec3> refined_points(builder.vertexCount()), refined_uvs(builder.vertexCount());
+        refined_points[0] = points[0];
+        refined_uvs[0] = uvs[0];
+        for (int ring = 1; ring <= rings; ++ring) {
+            for (int point = 0; point < points_per_ring; ++point) {
+                size_t i = 1 + (size_t) (ring - 1) * points_per_ring + point;
+                float source_ring = (float) ring / scale;
+                float source_point = (float) point / scale;
+                refined_points[i] = sample(points, layout, source_ring, source_point);
+                refined_uvs[i] = sample(uvs, layout, source_ring, source_point);
+            }
+        }
+        WarpMeshData mesh;
+        builder.build(refined_points, refined_uvs, &mesh.vertices, &mesh.indices);
+
+        WarpIndex index;
+        index.setMesh(mesh);
+        index.setView(mvp, width, height);
+        auto start = std::chrono::steady_clock::now();
+        glm::vec2 uv;
+        index.query(0.0f, 0.0f, &uv);
+        auto end = std::chrono::steady_clock::now();
+        double build_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        // the scan is slow, it only gets a sample of the points
+        auto scan_queries = (size_t) std::max(std::min(queries, 200000 / scale / scale), 1);
+        std::vector<glm::vec2> scanned(scan_queries, glm::vec2(-1.0f, 0.0f));
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < scan_queries; ++i)
+            scanTriangles(mesh, mvp, width, height, query_points[i].x, query_points[i].y, &scanned[i]);
+        end = std::chrono::steady_clock::now();
+        double scan_rate = scan_queries / std::chrono::duration<double>(end - start).count();
+
+        start = std::chrono::steady_clock::now();
+        size_t inside = index.query(query_points.data(), query_points.size(), found.data());
+        end = std::chrono::steady_clock::now();
+        double index_rate = queries / std::chrono::duration<double>(end - start).count();
+
+        start = std::chrono::steady_clock::now();
+        index.query(query_points.data(), query_points.size(), found.data(), &pool);
+        end = std::chrono::steady_clock::now();
+        double pool_rate = queries / std::chrono::duration<double>(end - start).count();
+
+        // both use the same projection, results only differ by rounding or on edges between triangles
+        size_t mismatches = 0;
+        for (size_t i = 0; i < scan_queries; ++i) {
+            if ((scanned[i].x < 0.0f) != (found[i].x < 0.0f) ||
+                (scanned[i].x >= 0.0f && glm::length(scanned[i] - found[i]) > 1e-4f))
+                ++mismatches;
+        }
+
+        std::cout << index.triangleCount() << "  " << build_ms << "  " << scan_rate << "  " << index_rate << "  "
+                  << pool_rate << "  " << inside << "  " << mismatches << std::endl;
+    }
+    return 0;
+}
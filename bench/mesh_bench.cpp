@@ -0,0 +1,41 @@
+// Measures MeshBuilder build time against the ring count, single threaded and on all cores.
+// Usage: glwarp-bench-mesh [points per ring] [repetitions]
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../inc/mesh_builder.h"
+
+static double benchmark(const MeshBuilder &builder, const std::vector<glm::vec3> &points, int threads,
+                        int repetitions)
+{
+    std::vector<WarpVertex> vertices;
+    std::vector<uint32_t> indices;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+        builder.build(points, points, &vertices, &indices, threads);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+int main(int argc, char *argv[])
+{
+    int points_per_ring = argc > 1 ? std::atoi(argv[1]) : 128;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 20;
+    int cores = (int) std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::cout << "rings  vertices  triangles  1 thread ms  " << cores << " threads ms" << std::endl;
+    for (int rings = 8; rings <= 4096; rings *= 2) {
+        MeshBuilder builder(rings, points_per_ring);
+        std::vector<glm::vec3> points(builder.vertexCount(), glm::vec3(0.5f, 0.5f, 0.0f));
+
+        double single = benchmark(builder, points, 1, repetitions);
+        double threaded = benchmark(builder, points, cores, repetitions);
+        std::cout << rings << "  " << builder.vertexCount() << "  " << builder.indexCount() / 3 << "  " << single
+                  << "  " << threaded << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Compares FileIO::loadFile against the getline/istringstream loader it replaced on generated text meshes.
+// Usage: glwarp-bench-parse [points per ring] [repetitions] [-file <mesh file>]
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../inc/file_io.h"
+
+static bool loadStream(const char *filepath, std::vector<glm::vec3> *to_fill)
+{
+    std::ifstream f(filepath, std::ios::in);
+    if (!f.is_open())
+        return false;
+
+    std::string s;
+    while (getline(f, s)) {
+        std::istringstream iss(s);
+        float x, y, z;
+        if (!(iss >> x >> y >> z))
+            continue;
+        to_fill->push_back(glm::vec3(x, y, z));
+    }
+    return true;
+}
+
+// writes a dome shaped mesh the way the configurator does, with six significant digits
+static bool writeMesh(const std::string &path, int rings, int points_per_ring)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "0 0.715118 0\n");
+    for (int ring = 1; ring <= rings; ++ring) {
+        float radius = (float) ring / rings;
+        for (int point = 0; point < points_per_ring; ++point) {
+            float angle = 6.2831853f * point / points_per_ring;
+            std::fprintf(file, "%g %g %g\n", radius * std::cos(angle), 0.715118f - 0.3f * radius * radius,
+                         -radius * std::sin(angle) * 1e-3f);
+        }
+    }
+    std::fprintf(file, "%d %d %d\n", rings, points_per_ring, 1 + rings * points_per_ring);
+    return std::fclose(file) == 0;
+}
+
+static double benchmark(bool (*load)(const char *, std::vector<glm::vec3> *), const std::string &path,
+                        int repetitions, std::vector<glm::vec3> *points)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        points->clear();
+        load(path.c_str(), points);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+static bool matches(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int c = 0; c < 3; ++c) {
+            if (std::fabs(a[i][c] - b[i][c]) > std::fabs(b[i][c]) * 1e-6f)
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int points_per_ring = argc > 1 ? std::atoi(argv[1]) : 512;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::string file;
+    for (int i = 3; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-file")
+            file = argv[++i];
+    }
+
+    std::vector<std::string> paths;
+    if (!file.empty()) {
+        paths.push_back(file);
+    } else {
+        for (int rings = 64; rings <= 2048; rings *= 4) {
+            std::string path = "glwarp-bench-parse-" + std::to_string(rings) + ".mesh";
+            if (!writeMesh(path, rings, points_per_ring)) {
+                std::cout << "unable to write " << path << std::endl;
+                return 1;
+            }
+            paths.push_back(path);
+        }
+    }
+
+    // the loader reports every file it reads
+    std::cout.setstate(std::ios::failbit);
+    std::vector<std::string> rows;
+    for (const std::string &path : paths) {
+        std::vector<glm::vec3> expected;
+        std::vector<glm::vec3> points;
+        std::ifstream size_probe(path, std::ios::binary | std::ios::ate);
+        double megabytes = size_probe.tellg() / (1024.0 * 1024.0);
+
+        double stream_ms = benchmark(loadStream, path, repetitions, &expected);
+        double mapped_ms = benchmark(FileIO::loadFile, path, repetitions, &points);
+
+        std::ostringstream row;
+        row << path << ": " << megabytes << " MB, " << points.size() << " points, stream " << stream_ms
+            << " ms, mapped " << mapped_ms << " ms (" << stream_ms / mapped_ms << "x)"
+            << (matches(points, expected) ? "" : " MISMATCH");
+        rows.push_back(row.str());
+
+        if (file.empty())
+            std::remove(path.c_str());
+    }
+    std::cout.clear();
+
+    for (const std::string &row : rows)
+        std::cout << row << std::endl;
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Measures the shared memory frame ring: a producer thread publishes frames while the consumer takes them through
+// ShmRingSource and copies them out like the capture thread does. First unpaced for throughput, then at 60 fps for
+// the delay between publishing and taking a frame. Every taken frame is checked for mixed up pixels.
+// Usage: glwarp-bench-ring [frames] [-size <w>x<h>] [-slots <n>]
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../inc/shm_ring.h"
+#include "../inc/shm_ring_source.h"
+
+struct RingResult {
+    unsigned long taken;
+    unsigned long torn;
+    unsigned long corrupt;
+    double seconds;
+    std::vector<double> delays_ms;
+};
+
+static uint64_t now()
+{
+    auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+// every frame starts and ends with its number, the pixels in between are what a renderer would write
+static void producer(ShmRingProducer *ring, int width, int height, int frames, double fps,
+                     std::vector<std::atomic<uint64_t>> *publish_times)
+{
+    std::vector<unsigned char> pattern((size_t) ring->stride() * height);
+    for (size_t i = 0; i < pattern.size(); ++i)
+        pattern[i] = (unsigned char) (i * 7);
+    size_t frame_size = (size_t) width * height * 4;
+
+    auto next_frame = std::chrono::steady_clock::now();
+    for (uint64_t frame = 1; frame <= (uint64_t) frames; ++frame) {
+        unsigned char *slot = ring->beginFrame();
+        std::memcpy(slot, pattern.data(), pattern.size());
+        std::memcpy(slot, &frame, sizeof(frame));
+        std::memcpy(slot + frame_size - sizeof(frame), &frame, sizeof(frame));
+        (*publish_times)[frame].store(now());
+        ring->publish(now());
+
+        if (fps > 0.0) {
+            next_frame += std::chrono::microseconds((long) (1e6 / fps));
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+}
+
+static RingResult benchmark(const std::string &name, int width, int height, int slots, int frames, double fps)
+{
+    RingResult result = {0, 0, 0, 0.0, {}};
+    ShmRingProducer ring;
+    if (!ring.create(name, width, height, PixelFormat::BGRA, slots))
+        return result;
+
+    FrameSourceSettings settings = {};
+    settings.path = name;
+    ShmRingSource source(settings);
+    if (!source.open())
+        return result;
+
+    std::vector<std::atomic<uint64_t>> publish_times((size_t) frames + 1);
+    std::vector<unsigned char> copy((size_t) width * height * 4);
+    size_t frame_size = copy.size();
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread thread(producer, &ring, width, height, frames, fps, &publish_times);
+    uint64_t last = 0;
+    while (last < (uint64_t) frames) {
+        SourceFrame frame;
+        if (source.acquire(&frame) != FrameSource::ACQUIRED) {
+            source.waitForFrame(0.1);
+            continue;
+        }
+        uint64_t taken_at = now();
+        std::memcpy(copy.data(), frame.pixels, frame_size);
+        bool intact = source.frameIntact();
+        source.release();
+        if (!intact) {
+            ++result.torn;
+            continue;
+        }
+
+        uint64_t first;
+        uint64_t end;
+        std::memcpy(&first, copy.data(), sizeof(first));
+        std::memcpy(&end, copy.data() + frame_size - sizeof(end), sizeof(end));
+        if (first != end || first <= last || first > (uint64_t) frames) {
+            ++result.corrupt;
+            continue;
+        }
+        last = first;
+        ++result.taken;
+        result.delays_ms.push_back((double) (taken_at - publish_times[first].load()) / 1e6);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    thread.join();
+
+    source.close();
+    ring.close();
+    return result;
+}
+
+static void print(const char *label, const RingResult &result, int width, int height, int frames)
+{
+    if (result.taken == 0) {
+        std::cout << label << ": no frames taken" << std::endl;
+        return;
+    }
+
+    std::vector<double> delays(result.delays_ms);
+    std::sort(delays.begin(), delays.end());
+    double median = delays.empty() ? 0.0 : delays[delays.size() / 2];
+    double worst = delays.empty() ? 0.0 : delays.back();
+    double gigabytes = (double) result.taken * width * height * 4 / 1e9;
+    std::cout << label << ": published " << frames / result.seconds << " fps, took " << result.taken << " frames ("
+              << gigabytes / result.seconds << " GB/s), " << result.torn << " torn, " << result.corrupt
+              << " corrupt, delay median " << median << " ms, max " << worst << " ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int width = 1920;
+    int height = 1080;
+    int slots = 3;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-size" && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (arg == "-slots" && i + 1 < argc)
+            slots = std::atoi(argv[++i]);
+    }
+
+    std::string name = "/glwarp-bench-" + std::to_string(getpid());
+    RingResult unpaced = benchmark(name, width, height, slots, frames, 0.0);
+    print("unpaced", unpaced, width, height, frames);
+    // a few seconds of a paced producer
+    int paced_frames = std::min(frames, 300);
+    RingResult paced = benchmark(name, width, height, slots, paced_frames, 60.0);
+    print("60 fps", paced, width, height, paced_frames);
+    return unpaced.corrupt + paced.corrupt > 0 ? 1 : 0;
+}
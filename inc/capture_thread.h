@@ -0,0 +1,87 @@
+#ifndef CAPTURE_THREAD_H
+#define CAPTURE_THREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_source.h"
+#include "frame_ring.h"
+#include "frame_recorder.h"
+
+/**
+ * Acquires frames from a FrameSource on its own thread and publishes them into a FrameRing, so a slow capture
+ * never stalls the render loop. Nothing is published while the source reports no change, and only the dirty
+ * regions are copied into the ring slots, converted to a 32 bit layout if the source delivers something else.
+ * Frames can be box-downscaled by an integer factor before they are published. Acquired frames can additionally be
+ * recorded to a frame file for later replay.
+ *
+ * A source that keeps its frames in place until they are released, like a shared memory ring of at least three
+ * slots, needs no thread when nothing is downscaled, converted or recorded. The render thread then takes frames
+ * from the source itself and uploads them straight from there, without a copy into the ring.
+ */
+class CaptureThread {
+
+public:
+    CaptureThread();
+    ~CaptureThread();
+
+    // takes ownership of the source
+    bool start(FrameSource *source, double capture_fps);
+    void stop();
+
+    void setDownscale(int factor);
+    // records every acquired frame at source resolution, must be set before start()
+    void setRecordPath(const std::string &path);
+
+    FrameRing &ring();
+    const FrameSource *source() const;
+    // frames are taken with acquireDirect() instead of from the ring
+    bool isDirect() const;
+    int width() const;
+    int height() const;
+
+    // render thread, direct mode only: the newest frame if there is a new one, valid until releaseDirect(). timing
+    // gets the sequence and capture times of the frame but no pixels.
+    bool acquireDirect(SourceFrame *frame, Frame *timing);
+    // false if the producer overwrote the frame while it was in use
+    bool releaseDirect();
+
+private:
+    struct DirtyHistory {
+        unsigned long sequence;
+        bool full;
+        std::vector<Rect> rects;
+    };
+
+    void run();
+    // false if the source frame turned out torn
+    bool publishFrame(const SourceFrame &source_frame, uint64_t capture_start);
+    void copyToSlot(const SourceFrame &source_frame, Frame *frame);
+    void copyRegion(const SourceFrame &source_frame, Frame *frame, const Rect &rect);
+    void convertRegion(const SourceFrame &source_frame, Frame *frame, const Rect &rect);
+
+    static const int HISTORY_LENGTH = 8;
+
+    FrameSource *source_;
+    FrameRing ring_;
+
+    int downscale_;
+    std::deque<DirtyHistory> history_;
+    std::vector<unsigned char> convert_buffer_;
+
+    std::string record_path_;
+    FrameRecorder recorder_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+    double capture_interval_;
+
+    bool direct_;
+    std::chrono::steady_clock::time_point next_direct_;
+};
+
+#endif
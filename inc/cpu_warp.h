@@ -0,0 +1,65 @@
+#ifndef CPU_WARP_H
+#define CPU_WARP_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "mesh_loader.h"
+#include "thread_pool.h"
+
+/**
+ * Software reference of the GL warp for machines without a GPU. The mesh is rasterised once, perspective correct
+ * and depth tested like GL does it, into the texture coordinate of every output pixel. Frames are then remapped
+ * through this map with bilinear filtering and repeat wrapping, matching the sampler state of the capture texture.
+ * The output is split into tiles that are warped on a thread pool, using AVX2 gathers when the CPU supports them.
+ */
+class CpuWarp {
+
+public:
+    // output tiles, small enough that the source pixels a tile samples stay in cache
+    static const int TILE_WIDTH = 64;
+    static const int TILE_HEIGHT = 16;
+
+    // threads <= 0 uses all cores
+    explicit CpuWarp(int threads = 0);
+
+    bool bake(const WarpMeshData &mesh, const glm::mat4 &mvp, int width, int height);
+
+    // remaps a 32 bit image into width() x height() pixels with top-down rows, keeping its channel order. Pixels
+    // outside the mesh are black, alpha is opaque.
+    void warp(const unsigned char *src, int src_width, int src_height, int src_stride, unsigned char *dst,
+              int dst_stride);
+
+    int width() const;
+    int height() const;
+    int threadCount() const;
+    // fraction of the output covered by the mesh
+    double coverage() const;
+
+    static const char *kernelName();
+
+    void warpScalar(const unsigned char *src, int src_width, int src_height, int src_stride, unsigned char *dst,
+                    int dst_stride);
+
+private:
+    struct WindowVertex {
+        float x;
+        float y;
+        float z;
+        float inverse_w;
+    };
+
+    void bakeBand(const std::vector<WindowVertex> &window, const WarpMeshData &mesh, int y_begin, int y_end);
+    void warpTiles(const unsigned char *src, int src_width, int src_height, int src_stride, unsigned char *dst,
+                   int dst_stride, bool simd);
+
+    ThreadPool pool_;
+    int width_;
+    int height_;
+
+    // texture coordinates with the v axis already flipped like in simple.frag, u is negative outside the mesh
+    std::vector<float> map_u_;
+    std::vector<float> map_t_;
+};
+
+#endif
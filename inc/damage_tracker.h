@@ -0,0 +1,48 @@
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+#include <vector>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+
+#include "frame.h"
+
+/**
+ * Tracks which parts of a window region changed, using the XDamage extension. Damage is accumulated by the
+ * X server and fetched as a list of rectangles relative to the tracked region.
+ */
+class DamageTracker {
+
+public:
+    DamageTracker(Display *display, Window window);
+    ~DamageTracker();
+
+    bool open(int x, int y, int width, int height, float full_frame_threshold);
+    void close();
+    bool isOpen() const;
+
+    // returns false if nothing changed, otherwise fills rects or sets full if the damage is too large
+    bool collect(std::vector<Rect> *rects, bool *full);
+
+    void waitForDamage(double timeout_seconds);
+
+private:
+    static const int MAX_RECTS = 32;
+
+    Display *display_;
+    Window window_;
+    Damage damage_;
+    XserverRegion parts_;
+    int event_base_;
+    bool pending_;
+
+    int x_;
+    int y_;
+    int width_;
+    int height_;
+    float threshold_;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include "frame.h"
+
+/**
+ * Integer box filter for 32 bit pixels. Every destination pixel is the rounded mean of a factor x factor block of
+ * source pixels, computed per byte channel. Uses AVX2 or SSE2 kernels when the CPU supports them.
+ */
+class Downscale {
+
+public:
+    // downscales the destination rectangle dst_rect, the source block of every pixel has to be readable
+    static void box(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+                    const Rect &dst_rect);
+
+    // destination rectangle covering all pixels a changed source rectangle contributes to
+    static Rect scaleRect(const Rect &src_rect, int factor, int dst_width, int dst_height);
+
+    static const char *kernelName();
+
+    static void boxScalar(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+                          const Rect &dst_rect);
+};
+
+#endif
@@ -4,11 +4,31 @@
 #include <glm/vec3.hpp>
 #include <vector>
 
+/**
+ * Layout line at the end of a mesh or texture coordinate file.
+ */
+struct MeshLayout {
+    int rings;
+    int points_per_ring;
+    int point_count;
+};
+
 class FileIO {
 
 public:
+    // files above this size are parsed by several threads
+    static const size_t PARALLEL_CHUNK_SIZE = 1 << 20;
+
+    // one "x y z" per line, the file is mapped and parsed without locale or stream overhead
     static bool loadFile(const char *filepath, std::vector<glm::vec3> *to_fill);
 
+    // points followed by the layout line, exactly point_count points are returned
+    static bool loadMesh(const char *filepath, std::vector<glm::vec3> *points, MeshLayout *layout);
+
+    // locale independent decimal parser that rounds like strtof, stops at the first character that can not continue
+    // the number
+    static const char *parseFloat(const char *begin, const char *end, float *value);
+
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,67 @@
+#ifndef FILE_SOURCE_H
+#define FILE_SOURCE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_source.h"
+
+/**
+ * Header of a raw frame sequence file. It is followed by the frames, each one a 64 bit capture timestamp in
+ * nanoseconds and stride * height bytes of pixels in the given PixelFormat. All values are in the byte order of
+ * the recording host, a file from a host of the other byte order fails the version check and is rejected.
+ */
+struct FrameFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t frame_count;
+    uint32_t reserved;
+};
+
+/**
+ * Plays back a raw frame sequence file in a loop. The file is memory mapped and frames are handed out without
+ * copying, the following frames are prefetched while the current one is in use. Frames are either paced by their
+ * recorded timestamps or delivered as fast as possible.
+ */
+class FileSource : public FrameSource {
+
+public:
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+    static const int READAHEAD_FRAMES = 4;
+
+    explicit FileSource(const FrameSourceSettings &settings);
+    ~FileSource() override;
+
+    bool open() override;
+    void close() override;
+
+    const char *name() const override;
+    int width() const override;
+    int height() const override;
+    PixelFormat::Format format() const override;
+
+protected:
+    Result acquireFrame(SourceFrame *frame) override;
+
+private:
+    const unsigned char *frameRecord(uint32_t index) const;
+    void readahead(uint32_t index);
+
+    FrameSourceSettings settings_;
+    unsigned char *mapping_;
+    size_t mapping_size_;
+    size_t record_size_;
+    FrameFileHeader header_;
+
+    uint32_t next_frame_;
+    uint64_t first_timestamp_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Reports writes to a set of files through inotify. The containing directories are watched rather than the files
+ * themselves, so files that editors replace by renaming a temporary copy over them are still followed.
+ */
+class FileWatcher {
+
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    bool init();
+    void close();
+
+    bool watch(const std::string &path);
+
+    // waits up to timeout_ms for changes and returns the watched paths that were written or replaced, without
+    // inotify it just sleeps
+    std::vector<std::string> wait(int timeout_ms);
+
+private:
+    struct Watch {
+        int descriptor;
+        std::string name;
+        std::string path;
+    };
+
+    int fd_;
+    std::vector<Watch> watches_;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+#include <vector>
+
+#include "pixel_format.h"
+
+/**
+ * Axis aligned pixel rectangle, in frame coordinates.
+ */
+struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/**
+ * A single captured frame. Unless full is set, only the dirty rectangles changed compared to the frame with the
+ * previous sequence number.
+ */
+struct Frame {
+    std::vector<unsigned char> pixels;
+    int width;
+    int height;
+    int stride;
+    PixelFormat::Format format;
+    unsigned long sequence;
+    // steady clock nanoseconds when the source was asked for the frame and when it was published
+    uint64_t capture_start;
+    uint64_t capture_end;
+
+    bool full;
+    std::vector<Rect> dirty;
+};
+
+#endif
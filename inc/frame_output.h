@@ -0,0 +1,98 @@
+#ifndef FRAME_OUTPUT_H
+#define FRAME_OUTPUT_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Renders into an offscreen framebuffer and writes every frame as raw top-down BGRA rows to a file, a named pipe
+ * or stdout, while still showing it in the window. The frame is resolved and copied to the window, then read
+ * into the next of a ring of pixel buffer objects. A fence per buffer tells when its copy is complete, so
+ * glReadPixels never waits for the GPU. Finished readbacks are copied into a small pool of frames that a writer
+ * thread drains. If the writer falls behind, e.g. a slow pipe reader, frames are dropped and counted instead of
+ * stalling rendering.
+ */
+class FrameOutput {
+
+public:
+    static const int READBACK_BUFFERS = 3;
+    static const int QUEUED_FRAMES = 4;
+
+    FrameOutput();
+    ~FrameOutput();
+
+    // moves everything printed to stderr, so stdout carries nothing but frames. Called before anything is printed.
+    static void takeStdout();
+
+    // path "-" writes to stdout, see takeStdout(). A named pipe is opened on the writer thread, so rendering starts
+    // before a reader connects.
+    bool init(const std::string &path, int width, int height, int samples, bool depth);
+    void release();
+    // follows the window, frames from then on are written at the new size. Frames already read back are
+    // still written at the old one.
+    void resize(int width, int height);
+
+    // directs rendering into the offscreen framebuffer
+    void bind();
+    // shows the frame in the window and reads it back, finished readbacks are handed to the writer
+    void finishFrame();
+
+    unsigned long writtenCount() const;
+    unsigned long droppedCount() const;
+
+private:
+    static const size_t WRITE_BUFFER_SIZE = 8 << 20;
+    static const int PIPE_RETRY_MS = 20;
+
+    // a frame keeps the size it was read back at, the writer may still hold it when the window is resized
+    struct Frame {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    bool createBuffers();
+    void releaseBuffers();
+    void collect(bool wait);
+    std::FILE *openFile();
+    void run();
+
+    std::string path_;
+    int width_;
+    int height_;
+    int samples_;
+    bool depth_;
+    size_t frame_size_;
+
+    GLuint framebuffer_;
+    GLuint color_buffer_;
+    GLuint depth_buffer_;
+    GLuint resolve_framebuffer_;
+    GLuint resolve_buffer_;
+
+    GLuint pixel_buffers_[READBACK_BUFFERS];
+    GLsync fences_[READBACK_BUFFERS];
+    int next_buffer_;
+    int pending_;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::vector<Frame> frames_;
+    std::vector<int> free_frames_;
+    std::deque<int> queued_frames_;
+    std::thread thread_;
+    bool running_;
+
+    std::atomic<unsigned long> written_;
+    std::atomic<unsigned long> dropped_;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "frame_source.h"
+
+/**
+ * Writes acquired frames with their capture timestamps into a raw frame sequence file that FileSource plays back.
+ * The frame count in the header is filled in on close, an interrupted recording stays readable.
+ */
+class FrameRecorder {
+
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+
+    bool open(const std::string &path, int width, int height, PixelFormat::Format format);
+    void close();
+    bool isOpen() const;
+
+    bool write(const SourceFrame &frame, uint64_t timestamp_ns);
+
+    unsigned long frameCount() const;
+
+private:
+    static const size_t WRITE_BUFFER_SIZE = 8 << 20;
+
+    std::FILE *file_;
+    std::string path_;
+    int width_;
+    int height_;
+    PixelFormat::Format format_;
+    unsigned long frame_count_;
+};
+
+#endif
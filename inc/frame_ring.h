@@ -0,0 +1,43 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+
+#include "frame.h"
+
+/**
+ * Lock-free triple buffer between one producer (the capture thread) and one consumer (the render loop).
+ * The producer always owns a back slot to write into, the consumer always owns a front slot to read from and the
+ * third slot holds the newest complete frame. Neither side ever waits for the other.
+ */
+class FrameRing {
+
+public:
+    FrameRing();
+
+    // producer side
+    Frame *writeSlot();
+    void publish();
+
+    // consumer side, returns nullptr if no new frame was published since the last call
+    const Frame *acquire();
+
+    unsigned long publishedCount() const;
+    unsigned long droppedCount() const;
+    unsigned long reusedCount() const;
+
+private:
+    static const int FRESH_BIT = 4;
+    static const int INDEX_MASK = 3;
+
+    Frame slots_[3];
+    int back_;
+    int front_;
+    std::atomic<int> middle_;
+
+    std::atomic<unsigned long> published_;
+    std::atomic<unsigned long> dropped_;
+    std::atomic<unsigned long> reused_;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+/**
+ * Settings shared by all frame sources, unused fields are ignored by the individual source.
+ */
+struct FrameSourceSettings {
+    int x;
+    int y;
+    int width;
+    int height;
+    float damage_threshold;
+    std::string path;
+    // recorded sources keep their original frame timing instead of delivering as fast as possible
+    bool realtime;
+};
+
+/**
+ * View of a frame owned by the source, valid until release() is called.
+ */
+struct SourceFrame {
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int stride;
+    PixelFormat::Format format;
+
+    bool full;
+    std::vector<Rect> dirty;
+};
+
+struct FrameSourceStats {
+    unsigned long acquired;
+    unsigned long unchanged;
+    unsigned long failed;
+    double acquire_seconds;
+};
+
+/**
+ * Something that delivers frames: the X server, a recorded file, another process or a generated pattern.
+ */
+class FrameSource {
+
+public:
+    enum Result {
+        ACQUIRED,
+        UNCHANGED,
+        FAILED
+    };
+
+    FrameSource();
+    virtual ~FrameSource();
+
+    static FrameSource *create(const std::string &type, const FrameSourceSettings &settings);
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    Result acquire(SourceFrame *frame);
+    // false if the frame was overwritten while it was in use, for memory another process writes to
+    virtual bool frameIntact();
+    virtual void release();
+    // frames are already in memory that nothing overwrites before release(), copying them on would only add a copy
+    virtual bool framesInPlace() const;
+
+    // blocks until a new frame may be available or the timeout passed
+    virtual void waitForFrame(double timeout_seconds);
+
+    virtual const char *name() const = 0;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    // layout of the delivered pixels, BGRA unless the source says otherwise
+    virtual PixelFormat::Format format() const;
+
+    const FrameSourceStats &stats() const;
+
+protected:
+    virtual Result acquireFrame(SourceFrame *frame) = 0;
+
+private:
+    FrameSourceStats stats_;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+
+/**
+ * Follows every presented frame from capture to buffer swap. The render loop stamps upload, draw and swap on the
+ * CPU and brackets upload and draw with GL timestamp queries, the capture times travel with the frame. Complete
+ * samples go into a fixed-size ring owned by the render thread. A CSV dump copies the ring there and writes the
+ * copy on a helper thread, so it never stalls rendering. All times are steady clock nanoseconds, GPU times are
+ * mapped onto it.
+ */
+class LatencyTracker {
+
+public:
+    struct Sample {
+        unsigned long sequence;
+        // a new capture was uploaded for this frame, otherwise the previous one was shown again
+        bool fresh;
+        uint64_t capture_start;
+        uint64_t capture_end;
+        uint64_t upload_submit;
+        uint64_t draw_submit;
+        uint64_t swap_return;
+        uint64_t gpu_start;
+        uint64_t gpu_end;
+    };
+
+    LatencyTracker();
+    ~LatencyTracker();
+
+    bool init(size_t capacity = 4096);
+    void release();
+
+    static uint64_t now();
+
+    // render loop, in this order for every frame. uploadStarted() and frameUploaded() only for frames that upload a
+    // new capture.
+    void beginFrame();
+    void uploadStarted();
+    void frameUploaded(const Frame &frame);
+    void drawSubmitted();
+    void endFrame();
+
+    // render thread, like the frame calls
+    std::vector<Sample> snapshot() const;
+    void printSummary() const;
+    bool writeCSV(const std::string &path) const;
+    // writes a copy of the samples on a helper thread
+    void dumpCSV(const std::string &path);
+
+private:
+    static const int QUERY_FRAMES = 4;
+
+    static bool writeSamples(const std::string &path, const std::vector<Sample> &samples);
+
+    void publish(const Sample &sample);
+    void resolvePending(bool wait);
+    void calibrate();
+
+    std::vector<Sample> samples_;
+    uint64_t written_;
+
+    Sample current_;
+    Sample displayed_;
+    Sample pending_[QUERY_FRAMES];
+    GLuint queries_[QUERY_FRAMES][2];
+    int pending_head_;
+    int pending_count_;
+
+    // steady clock minus GL clock
+    int64_t gpu_offset_;
+    uint64_t last_calibration_;
+
+    std::thread dump_thread_;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MESH_BUILDER_H
+#define MESH_BUILDER_H
+
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Position and texture coordinate of one mesh point, interleaved in a single vertex buffer.
+ */
+struct WarpVertex {
+    float x;
+    float y;
+    float z;
+    float u;
+    float v;
+};
+
+/**
+ * Builds the vertex and index arrays of a ring mesh: a center point followed by rings with a fixed number of points
+ * each, from the inside out. The center is connected to the first ring by a triangle fan, neighbouring rings by two
+ * triangles per quad. Sizes are known up front, so the arrays are allocated once and large meshes can be filled by
+ * several threads, each taking a range of rings.
+ */
+class MeshBuilder {
+
+public:
+    // below this many rings per thread the thread start costs more than it saves
+    static const int MIN_RINGS_PER_THREAD = 32;
+
+    MeshBuilder(int rings, int points_per_ring);
+
+    bool isValid() const;
+    size_t vertexCount() const;
+    size_t indexCount() const;
+
+    // positions and uvs have one entry per point, threads <= 0 uses all cores
+    bool build(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &uvs,
+               std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices, int threads = 1) const;
+    // only the topology, for meshes whose vertices come from elsewhere
+    void buildIndices(std::vector<uint32_t> *indices) const;
+
+    int rings() const;
+    int pointsPerRing() const;
+
+private:
+    void buildRings(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &uvs,
+                    WarpVertex *vertices, uint32_t *indices, int first_ring, int last_ring) const;
+    void buildRingIndices(uint32_t *indices, int first_ring, int last_ring) const;
+
+    int rings_;
+    int points_per_ring_;
+};
+
+#endif
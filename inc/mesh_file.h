@@ -0,0 +1,63 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_builder.h"
+
+/**
+ * Header of a binary warp mesh (.wmesh). The interleaved vertices (WarpVertex) and the optional triangle indices
+ * follow at the given offsets, both 16 byte aligned. Indices are 16 bit if the mesh has at most 65536 vertices and
+ * 32 bit otherwise, so both arrays can be handed to GL as they are. All values are in the byte order of the host
+ * that wrote the file, a file from a host of the other byte order fails the version check and is rejected.
+ */
+struct MeshFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rings;
+    uint32_t points_per_ring;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size;
+    uint32_t flags;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+};
+
+/**
+ * Reads binary warp meshes by mapping them into memory. open() checks every index against the vertex count, the
+ * vertex and index data is then copied out of the mapping.
+ */
+class MeshFile {
+
+public:
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+
+    // the indices are ordered for the vertex cache
+    static const uint32_t FLAG_OPTIMIZED = 1;
+
+    MeshFile();
+    ~MeshFile();
+
+    static bool write(const std::string &path, int rings, int points_per_ring, const std::vector<WarpVertex> &vertices,
+                      const std::vector<uint32_t> *indices, uint32_t flags = 0);
+
+    bool open(const std::string &path);
+    void close();
+
+    const MeshFileHeader &header() const;
+    const WarpVertex *vertices() const;
+    // nullptr if the file holds no indices
+    const void *indices() const;
+
+private:
+    unsigned char *mapping_;
+    size_t mapping_size_;
+    MeshFileHeader header_;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_builder.h"
+
+/**
+ * A built mesh in CPU memory, ready to be uploaded or rendered.
+ */
+struct WarpMeshData {
+    std::vector<WarpVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+/**
+ * Reads text and binary meshes into memory without touching GL, so it can run on any thread and in tools that
+ * have no GPU.
+ */
+class MeshLoader {
+
+public:
+    // .wmesh files are binary meshes that carry their texture coordinates
+    static bool isBinary(const std::string &path);
+    // builds a text mesh and texture coordinate pair or reads a binary mesh, tex_path is ignored for the latter
+    static bool load(const std::string &mesh_path, const std::string &tex_path, bool optimize, WarpMeshData *data);
+
+    // reorders triangles and vertices for the post-transform cache
+    static void optimize(std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices);
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh_builder.h"
+
+/**
+ * Reorders indexed triangle lists for the GPU: triangles so that consecutive ones share recently transformed
+ * vertices (Tom Forsyth's linear-speed vertex cache optimisation), vertices so that they are fetched in the order
+ * the triangles first use them.
+ */
+class MeshOptimizer {
+
+public:
+    static const int CACHE_SIZE = 32;
+
+    static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, int vertex_count);
+    static void optimizeVertexFetch(std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices);
+
+    // average cache miss ratio: transformed vertices per triangle for a FIFO cache of the given size
+    static double acmr(const std::vector<uint32_t> &indices, int vertex_count, int cache_size);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef MESH_RELOADER_H
+#define MESH_RELOADER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "file_watcher.h"
+#include "json11.hpp"
+#include "warp_generator.h"
+#include "warp_mesh.h"
+
+/**
+ * Reloads the mesh, texture coordinate and config files on its own thread whenever they are saved or a reload is
+ * requested. Files are parsed and the mesh is built and optimised in the background, the render loop only picks
+ * up finished results, so a new calibration never stalls projection. Files that fail to load, e.g. because they
+ * are still being written, leave the current mesh in place. A mesh generated from the config is generated again
+ * whenever the config changes.
+ */
+class MeshReloader {
+
+public:
+    // changes arriving within this time are collected into one reload, editors often write files in parts
+    static const int SETTLE_MS = 200;
+
+    MeshReloader();
+    ~MeshReloader();
+
+    // with generate the mesh comes from the geometry in the config, the mesh and texture coordinate files are unused
+    bool start(const std::string &mesh_path, const std::string &tex_path, const std::string &config_path,
+               bool optimize, bool watch, bool generate = false);
+    void stop();
+
+    // reloads all files regardless of changes
+    void request();
+
+    // hand over a finished result, never block
+    bool takeMesh(WarpMeshData *data);
+    bool takeConfig(json11::Json *config);
+
+private:
+    void run();
+    void reload(bool mesh, bool config);
+
+    std::string mesh_path_;
+    std::string tex_path_;
+    std::string config_path_;
+    bool optimize_;
+    bool generate_;
+    // only created when generating, its threads are reused by every reload
+    std::unique_ptr<WarpGenerator> generator_;
+    FileWatcher watcher_;
+
+    std::mutex mutex_;
+    WarpMeshData mesh_;
+    json11::Json config_;
+    std::atomic<bool> mesh_ready_;
+    std::atomic<bool> config_ready_;
+
+    std::atomic<bool> requested_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+/**
+ * Byte layouts of the pixels handed around by sources, the capture ring and the texture uploads, and conversions
+ * between them. The 32 bit formats can be uploaded as they are, everything else is converted to the 32 bit format
+ * with the same channel order first. Conversions use AVX2, SSSE3 or NEON kernels when the CPU supports them.
+ */
+class PixelFormat {
+
+public:
+    // values are stored in frame files, only append
+    enum Format {
+        BGRA = 0,
+        RGBA = 1,
+        BGR = 2,
+        RGB = 3,
+        UNKNOWN = 255
+    };
+
+    // format of an XImage style layout, UNKNOWN for anything that is not 8 bits per channel
+    static Format fromMasks(int bits_per_pixel, unsigned long red_mask, unsigned long green_mask,
+                            unsigned long blue_mask, bool msb_first);
+
+    static int bytesPerPixel(Format format);
+    // the format can be uploaded without conversion
+    static bool isDirect(Format format);
+    // 32 bit format with the same channel order
+    static Format directFormat(Format format);
+    static const char *name(Format format);
+
+    // converts to BGRA or RGBA with opaque alpha, removing row padding and optionally flipping the rows
+    static bool convert(const unsigned char *src, int src_stride, Format src_format, unsigned char *dst,
+                        int dst_stride, Format dst_format, int width, int height, bool flip = false);
+
+    static const char *kernelName();
+
+    static bool convertScalar(const unsigned char *src, int src_stride, Format src_format, unsigned char *dst,
+                              int dst_stride, Format dst_format, int width, int height, bool flip = false);
+};
+
+#endif
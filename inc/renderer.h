@@ -0,0 +1,55 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "warp_mesh.h"
+
+/**
+ * Draws the warp mesh with the textured shader and remembers the GL state it set. The program, MVP and texture
+ * are only sent to GL when they differ from what was set before, so a frame without changes is a clear, a vertex
+ * array bind and a draw. Any number of view changes within a frame become one uniform update on the next draw.
+ * Code that changes the program or texture binding behind the renderer has to call invalidate().
+ *
+ * Without depth the mesh is drawn without depth test and only color is cleared, the warp is a single surface
+ * that never overlaps itself.
+ */
+class Renderer {
+
+public:
+    Renderer();
+    ~Renderer();
+
+    bool init(const char *vertex_path, const char *fragment_path, bool depth = true);
+    void release();
+
+    // only recorded, applied by the next draw
+    void setView(const glm::mat4 &mvp);
+    void setTexture(GLuint texture);
+    void invalidate();
+
+    // starts counting the GL calls of a frame, optionally clearing the framebuffer
+    void beginFrame(bool clear);
+    void draw(const WarpMesh &mesh, bool points);
+
+    // GL calls the renderer and the mesh issued since the last beginFrame(). Texture upload, output readback and
+    // latency queries happen outside and are not counted.
+    int callCount() const;
+
+private:
+    GLuint program_;
+    GLint mvp_id_;
+    GLint sampler_id_;
+    bool depth_;
+
+    glm::mat4 mvp_;
+    GLuint texture_;
+
+    bool program_dirty_;
+    bool mvp_dirty_;
+    bool texture_dirty_;
+    int calls_;
+};
+
+#endif
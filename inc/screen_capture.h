@@ -0,0 +1,47 @@
+#ifndef SCREEN_CAPTURE_H
+#define SCREEN_CAPTURE_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "pixel_format.h"
+
+/**
+ * Grabs a fixed region of a window (usually the root window) into an XImage that is allocated once and reused
+ * for every frame. Uses the MIT-SHM extension when the X server supports it and falls back to XGetImage otherwise.
+ */
+class ScreenCapture {
+
+public:
+    ScreenCapture(Display *display, Window window);
+    ~ScreenCapture();
+
+    bool open(int x, int y, int width, int height, bool allow_shm = true);
+    void close();
+
+    XImage *grab();
+    XImage *grabRows(int y, int rows);
+
+    bool usesSharedMemory() const;
+    PixelFormat::Format format() const;
+    int width() const;
+    int height() const;
+
+private:
+    bool openShm();
+    void closeShm();
+
+    Display *display_;
+    Window window_;
+    XImage *image_;
+    XShmSegmentInfo shm_info_;
+    bool use_shm_;
+
+    int x_;
+    int y_;
+    int width_;
+    int height_;
+};
+
+#endif
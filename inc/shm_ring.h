@@ -0,0 +1,106 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "pixel_format.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "the ring is shared between processes and needs lock-free atomics");
+
+/**
+ * State of one slot of a shared memory frame ring. The sequence is a seqlock over the pixels of the slot: odd
+ * while the producer writes them, 2 * frame number once the frame is complete.
+ */
+struct ShmRingSlot {
+    std::atomic<uint64_t> sequence;
+};
+
+/**
+ * Header at the start of a POSIX shared memory object that carries frames from a producer process to glwarp.
+ * It is followed by slot_count slots of slot_size bytes starting at slot_offset, each holding one frame of
+ * stride * height bytes in the given PixelFormat. Geometry and format are written once by the producer before
+ * the magic and never change, a producer with a new size creates a new object.
+ *
+ * Publishing a frame, producer side:
+ *  1. pick a slot that is neither latest_slot nor reading, make its sequence odd and write the pixels
+ *  2. set the slot sequence to 2 * frame number
+ *  3. make sequence odd, store latest_slot, latest_frame and latest_timestamp, make sequence even again
+ *  4. FUTEX_WAKE on sequence, a consumer sleeps on it while no new frame is there
+ *
+ * Reading a frame, consumer side:
+ *  1. read latest_slot and latest_frame under the sequence seqlock, retry while it is odd or changed
+ *  2. store the slot in reading, then check that its sequence is still 2 * latest_frame
+ *  3. use the pixels in place, then check the slot sequence again. If it changed the producer wrapped around
+ *     onto the slot and the frame is discarded.
+ *  4. store NO_SLOT in reading
+ *
+ * Frame numbers start at 1, latest_frame is 0 before the first frame. All values are in host byte order, the
+ * ring only connects processes on the same machine.
+ */
+struct ShmRingHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t slot_offset;
+    // set by the producer when it goes away
+    std::atomic<uint32_t> closed;
+
+    // seqlock over the latest fields, also the futex word consumers wait on
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> latest_slot;
+    std::atomic<uint64_t> latest_frame;
+    // nanoseconds of the producer's steady clock
+    std::atomic<uint64_t> latest_timestamp;
+
+    // slot the consumer uses, written by the consumer only
+    std::atomic<uint32_t> reading;
+    uint32_t reserved;
+
+    // the first slot_count are used
+    ShmRingSlot slots[8];
+};
+
+/**
+ * Creates a frame ring and publishes frames into it, see ShmRingHeader for the protocol. Used by the reference
+ * producer and the ring benchmark, other producers only need the header layout.
+ */
+class ShmRingProducer {
+
+public:
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+    static const int MAX_SLOTS = 8;
+    static const uint32_t NO_SLOT = 0xffffffff;
+
+    ShmRingProducer();
+    ~ShmRingProducer();
+
+    // replaces an existing object of the same name
+    bool create(const std::string &name, int width, int height, PixelFormat::Format format, int slots);
+    // marks the ring closed, wakes the consumer and removes the object
+    void close();
+
+    int stride() const;
+
+    // slot for the next frame, written until publish()
+    unsigned char *beginFrame();
+    void publish(uint64_t timestamp);
+
+private:
+    std::string name_;
+    ShmRingHeader *header_;
+    size_t mapping_size_;
+    uint32_t write_slot_;
+    uint64_t frame_count_;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SHM_RING_SOURCE_H
+#define SHM_RING_SOURCE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_source.h"
+#include "shm_ring.h"
+
+/**
+ * Takes frames from a shared memory ring filled by another process, see ShmRingHeader for the protocol. The
+ * ring is mapped once and frames are handed out in place, only the newest one is taken, frames the producer
+ * published in between are skipped. A waiting capture thread sleeps on a futex the producer wakes, so frames are
+ * taken as soon as they are published. Frames the producer overwrote while they were copied are discarded.
+ * After the producer closed the ring the name is opened again now and then, so a restarted producer, also one
+ * with another frame size, is picked up.
+ */
+class ShmRingSource : public FrameSource {
+
+public:
+    explicit ShmRingSource(const FrameSourceSettings &settings);
+    ~ShmRingSource() override;
+
+    bool open() override;
+    void close() override;
+    void release() override;
+    void waitForFrame(double timeout_seconds) override;
+    bool frameIntact() override;
+    bool framesInPlace() const override;
+
+    const char *name() const override;
+    int width() const override;
+    int height() const override;
+    PixelFormat::Format format() const override;
+
+protected:
+    Result acquireFrame(SourceFrame *frame) override;
+
+private:
+    static const int REOPEN_INTERVAL_MS = 100;
+
+    ShmRingHeader *map(bool report, size_t *size) const;
+    void attach(ShmRingHeader *header, size_t size);
+    bool readLatest(uint32_t *slot, uint64_t *frame);
+
+    FrameSourceSettings settings_;
+    ShmRingHeader *header_;
+    size_t mapping_size_;
+
+    uint32_t seen_sequence_;
+    uint64_t last_frame_;
+    uint32_t acquired_slot_;
+    uint64_t acquired_sequence_;
+
+    unsigned long skipped_;
+    unsigned long torn_;
+    bool closed_reported_;
+    std::chrono::steady_clock::time_point next_reopen_;
+};
+
+#endif
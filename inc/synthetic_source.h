@@ -0,0 +1,43 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include <vector>
+
+#include "frame_source.h"
+
+/**
+ * Generates a deterministic test pattern without any display: static colour bars with a box moving across them
+ * and the frame number encoded as a strip of black and white blocks. Only the changed parts are reported dirty.
+ */
+class SyntheticSource : public FrameSource {
+
+public:
+    explicit SyntheticSource(const FrameSourceSettings &settings);
+
+    bool open() override;
+    void close() override;
+
+    const char *name() const override;
+    int width() const override;
+    int height() const override;
+
+protected:
+    Result acquireFrame(SourceFrame *frame) override;
+
+private:
+    static const int BOX_SIZE = 64;
+    static const int COUNTER_BITS = 32;
+
+    void drawBars(const Rect &rect);
+    void drawBox(int x, int y);
+    Rect counterRect() const;
+    void drawCounter();
+    Rect boxRect(unsigned long index) const;
+
+    int width_;
+    int height_;
+    std::vector<unsigned char> pixels_;
+    unsigned long frame_index_;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+#include "frame.h"
+
+/**
+ * Streams frames into a texture. In PBO mode the pixels are written into a ring of pixel buffer objects and the
+ * texture update is sourced from the buffer, so the driver can copy asynchronously while the CPU already fills the
+ * next buffer. Buffers are persistently mapped if ARB_buffer_storage exists, otherwise orphaned on every frame.
+ * A fence per buffer guards it from being overwritten while the GPU still reads from it.
+ * If regions are passed to upload only those rectangles are transferred, the rest of the texture is kept.
+ * BGRA and RGBA frames are handed to GL in their own layout, so the driver does no swizzling on the CPU.
+ */
+class TextureStreamer {
+
+public:
+    enum Mode {
+        SYNC,
+        PBO
+    };
+
+    TextureStreamer();
+    ~TextureStreamer();
+
+    bool init(int width, int height, Mode mode, int buffer_count = 3);
+    void release();
+
+    void upload(const unsigned char *pixels, int width, int height, int stride, PixelFormat::Format format,
+                const std::vector<Rect> *regions = nullptr);
+
+    GLuint texture() const;
+    int width() const;
+    int height() const;
+    bool isPersistent() const;
+
+private:
+    void uploadSync(const unsigned char *pixels, int stride, const std::vector<Rect> &regions);
+    void uploadPBO(const unsigned char *pixels, int stride, const std::vector<Rect> &regions);
+    void setUploadFormat(PixelFormat::Format format);
+    void waitForBuffer(int index);
+
+    GLuint texture_;
+    int width_;
+    int height_;
+    Mode mode_;
+    GLenum upload_format_;
+    GLenum upload_type_;
+
+    std::vector<GLuint> buffers_;
+    std::vector<GLsync> fences_;
+    std::vector<unsigned char *> mapped_;
+    size_t buffer_size_;
+    bool persistent_;
+    int next_buffer_;
+    std::vector<Rect> full_region_;
+    bool map_failed_reported_;
+};
+
+#endif
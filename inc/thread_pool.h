@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for data parallel loops that run every frame, so no threads are created on the
+ * hot path. The calling thread works on the loop as well.
+ */
+class ThreadPool {
+
+public:
+    // threads <= 0 uses all cores
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    int threadCount() const;
+
+    // runs task(i) for every i in [0, count) and returns once all of them finished
+    void run(int count, const std::function<void(int)> &task);
+
+private:
+    void work();
+    void runTasks();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(int)> *task_;
+    int count_;
+    std::atomic<int> next_;
+    int active_;
+    unsigned long generation_;
+    bool stopping_;
+};
+
+#endif
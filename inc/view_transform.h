@@ -0,0 +1,19 @@
+#ifndef VIEW_TRANSFORM_H
+#define VIEW_TRANSFORM_H
+
+#include <glm/glm.hpp>
+
+#include "json11.hpp"
+
+/**
+ * The transformation the warp mesh is rendered with, shared by the GL and the CPU renderer.
+ */
+class ViewTransform {
+
+public:
+    static glm::mat4 mvp(const glm::vec3 &model_position, const glm::vec3 &model_rotation);
+    // the mesh is placed opposite to the projector position of the model config
+    static glm::vec3 modelPosition(const json11::Json &config);
+};
+
+#endif
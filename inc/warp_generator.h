@@ -0,0 +1,67 @@
+#ifndef WARP_GENERATOR_H
+#define WARP_GENERATOR_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "json11.hpp"
+#include "mesh_loader.h"
+#include "thread_pool.h"
+
+/**
+ * The mirror dome setup of a model config, in its world units with y pointing up.
+ */
+struct WarpGeometry {
+    glm::vec3 projector_position;
+    // degrees around x, y and z, applied in that order to a projector looking along -z
+    glm::vec3 projector_rotation;
+    // vertical field of view in degrees and width / height of the projector image
+    float projector_fov;
+    float projector_aspect;
+    glm::vec3 mirror_position;
+    float mirror_radius;
+    glm::vec3 dome_position;
+    float dome_radius;
+    // projector rays traced for the initial guesses
+    int grid_rows;
+    int grid_columns;
+    // layout of the generated mesh
+    int rings;
+    int points_per_ring;
+};
+
+/**
+ * Builds the warp mesh from the geometry of a model config instead of reading it from files. Projector rays are
+ * reflected off the spherical mirror onto the dome. The texture coordinate of a dome point is its orthographic
+ * position on the dome base, so ring r of the mesh lies at r / rings of the way from the zenith to the horizon.
+ *
+ * For every mesh point the projector ray that lands on its dome point is searched: the projector image is traced
+ * on a grid of rays in parallel, the nearest of them is the start for a few Newton steps on the exact trace. Mesh
+ * points are where these rays pass through the plane one unit in front of the projector, offset by the projector
+ * position like the files of the external configurator.
+ */
+class WarpGenerator {
+
+public:
+    // threads <= 0 uses all cores
+    explicit WarpGenerator(int threads = 0);
+
+    static bool parse(const json11::Json &config, WarpGeometry *geometry);
+
+    // points and texture coordinates in the order of a mesh file pair
+    bool generate(const WarpGeometry &geometry, std::vector<glm::vec3> *points, std::vector<glm::vec3> *uvs);
+    // builds and optionally optimises the mesh like MeshLoader does with files
+    bool generate(const json11::Json &config, bool optimize, WarpMeshData *data);
+
+    // the projector image tangent of every mesh point. Tangents of the same layout, e.g. solved for a pose nearby,
+    // are the start of the search, so small pose changes take a step or two per point.
+    bool solve(const WarpGeometry &geometry, std::vector<glm::dvec2> *tangents);
+    static void textureCoordinates(const WarpGeometry &geometry, std::vector<glm::vec3> *uvs);
+
+    int threadCount() const;
+
+private:
+    ThreadPool pool_;
+};
+
+#endif
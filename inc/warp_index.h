@@ -0,0 +1,87 @@
+#ifndef WARP_INDEX_H
+#define WARP_INDEX_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mesh_loader.h"
+#include "thread_pool.h"
+
+/**
+ * Answers which source texture coordinate is shown at an output pixel, the inverse of the warp, for calibration
+ * and pointer mapping. The mesh is projected with the MVP into output pixels and its triangles are sorted into a
+ * uniform grid, a query only tests the few triangles of its cell and interpolates the texture coordinate
+ * perspective correct. Where triangles overlap the nearest one wins, like with the depth test of the renderer.
+ *
+ * The grid is rebuilt on the first query after the mesh or the view changed, so moving the mesh every frame costs
+ * nothing until something is looked up. Queries may run on any number of threads at once, each one works on the
+ * grid that was current when it started.
+ */
+class WarpIndex {
+
+public:
+    // the cell size follows the size of the projected triangles, within these limits in output pixels
+    static const int MIN_CELL_SIZE = 2;
+    static const int MAX_CELL_SIZE = 64;
+
+    WarpIndex();
+
+    void setMesh(const WarpMeshData &mesh);
+    // overwrites count vertices of the mesh from first on
+    void updateVertices(size_t first, const WarpVertex *vertices, size_t count);
+    // the output size the MVP maps the mesh to, nothing changes if both are the same as before
+    void setView(const glm::mat4 &mvp, int width, int height);
+
+    // x and y are output pixel coordinates with top-down rows, pixel centers are at half coordinates. The result
+    // has its v axis flipped like in simple.frag, so uv times the source size is the source pixel with top-down
+    // rows. Returns false outside the mesh.
+    bool query(float x, float y, glm::vec2 *uv);
+    // looks up count points, uv.x is negative for points outside the mesh. The points are split over the pool if
+    // one is given, the pool must not be used by another thread meanwhile. Returns the number of points inside.
+    size_t query(const glm::vec2 *points, size_t count, glm::vec2 *uvs, ThreadPool *pool = nullptr);
+
+    int triangleCount();
+
+private:
+    struct Triangle {
+        // output pixel positions, ordered so that all edge functions are positive inside
+        float x[3];
+        float y[3];
+        float z[3];
+        float inverse_w[3];
+        // texture coordinates divided by w, which are linear in screen space
+        float u_w[3];
+        float t_w[3];
+        float inverse_area;
+    };
+
+    struct Grid {
+        std::vector<Triangle> triangles;
+        float origin_x;
+        float origin_y;
+        float inverse_cell_size;
+        int columns;
+        int rows;
+        // the triangles of cell i are cell_triangles[cell_start[i]] up to cell_start[i + 1], in draw order
+        std::vector<uint32_t> cell_start;
+        std::vector<uint32_t> cell_triangles;
+    };
+
+    std::shared_ptr<const Grid> current();
+    void build(Grid *grid) const;
+    static bool lookup(const Grid &grid, float x, float y, glm::vec2 *uv);
+
+    std::mutex mutex_;
+    WarpMeshData mesh_;
+    glm::mat4 mvp_;
+    int width_;
+    int height_;
+    bool dirty_;
+    std::shared_ptr<Grid> grid_;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef WARP_LUT_H
+#define WARP_LUT_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "warp_mesh.h"
+
+/**
+ * Renders the warp without rasterising the mesh every frame. The mesh is baked once into a floating point RG
+ * lookup texture at output resolution that holds the texture coordinate of every output pixel, each frame is then
+ * a single fullscreen triangle doing a dependent texture fetch. The lookup is baked again whenever the MVP, the
+ * mesh or the output size changes.
+ */
+class WarpLut {
+
+public:
+    WarpLut();
+    ~WarpLut();
+
+    bool init(int width, int height);
+    void release();
+    // a new output resolution, the lookup is baked again on the next update
+    void resize(int width, int height);
+
+    // bakes the lookup if the mesh or the MVP changed since the last bake, returns true if it did
+    bool update(const WarpMesh &mesh, const glm::mat4 &mvp);
+    void draw(GLuint texture) const;
+
+private:
+    void bake(const WarpMesh &mesh, const glm::mat4 &mvp);
+
+    int width_;
+    int height_;
+    GLuint lookup_texture_;
+    GLuint depth_buffer_;
+    GLuint framebuffer_;
+
+    GLuint bake_program_;
+    GLint bake_mvp_id_;
+    GLuint warp_program_;
+    GLint lookup_sampler_id_;
+    GLint texture_sampler_id_;
+
+    bool baked_;
+    glm::mat4 baked_mvp_;
+    unsigned long baked_generation_;
+};
+
+#endif
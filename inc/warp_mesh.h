@@ -0,0 +1,99 @@
+#ifndef WARP_MESH_H
+#define WARP_MESH_H
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_builder.h"
+#include "mesh_loader.h"
+
+/**
+ * The warp mesh: a center point surrounded by rings with a fixed number of points each. Every point is stored
+ * once and the triangles reference them through an index buffer, so shared vertices are transformed only once.
+ * Optionally the triangle and vertex order is optimised for the vertex cache after building.
+ *
+ * The GPU buffers are double buffered: a new mesh is written into the back buffers, spread over several frames
+ * if it is staged, and swapped to the front once complete, so the current mesh is drawn until then. Each set of
+ * buffers has a vertex array with the attribute layout and index buffer set up once, a draw only binds it.
+ */
+class WarpMesh {
+
+public:
+    static const size_t UPLOAD_BYTES_PER_FRAME = 4 << 20;
+
+    WarpMesh();
+    ~WarpMesh();
+
+    // reads a mesh and a texture coordinate file, both end with a "rings points_per_ring point_count" line
+    bool load(const char *mesh_path, const char *tex_path);
+    // maps a binary .wmesh file and uploads its contents as they are
+    bool loadBinary(const char *path);
+    bool build(const std::vector<glm::vec3> &points, const std::vector<glm::vec3> &uvs, int rings,
+               int points_per_ring, int threads = 1);
+    void release();
+
+    // reorder triangles and vertices for the post-transform cache on the next build
+    void setOptimize(bool optimize);
+
+    // starts streaming a loaded mesh into the back buffers, a mesh that is still staged is replaced
+    void stage(WarpMeshData &&data);
+    // uploads the next part of the staged mesh and returns true once it was swapped to the front
+    bool continueStaging(size_t max_bytes = UPLOAD_BYTES_PER_FRAME);
+    bool isStaging() const;
+
+    // overwrites count vertices of the current mesh from first on, in place and without staging
+    bool updateVertices(size_t first, const WarpVertex *vertices, size_t count);
+    // the current mesh as drawn, from the copy kept in memory
+    bool copyData(WarpMeshData *data) const;
+
+    // returns the number of GL calls issued
+    int draw(bool points) const;
+
+    int vertexCount() const;
+    int triangleCount() const;
+    // changes whenever a new mesh is swapped to the front
+    unsigned long generation() const;
+
+private:
+    struct Buffers {
+        GLuint vertex_buffer;
+        GLuint edge_buffer;
+        GLuint index_buffer;
+        GLuint vertex_array;
+        GLenum index_type;
+        size_t vertex_count;
+        size_t index_count;
+    };
+
+    // per vertex 0 on the border of the mesh and 1 inside, for antialiasing the border in the shader
+    static std::vector<float> edgeAttribute(const std::vector<uint32_t> &indices, size_t vertex_count);
+    static std::vector<unsigned char> packIndices(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                                  size_t *index_size);
+
+    bool upload();
+    Buffers &back();
+    void allocate(Buffers *buffers, const void *vertices, const void *edges, size_t vertex_count,
+                  const void *indices, size_t index_count, size_t index_size);
+    static void bake(Buffers *buffers);
+    void swap();
+
+    std::vector<WarpVertex> vertices_;
+    std::vector<uint32_t> indices_;
+
+    Buffers buffers_[2];
+    int front_;
+    unsigned long generation_;
+
+    WarpMeshData staged_;
+    std::vector<float> staged_edges_;
+    std::vector<unsigned char> staged_indices_;
+    size_t staged_offset_;
+    bool staging_;
+
+    bool optimize_;
+};
+
+#endif
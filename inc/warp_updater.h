@@ -0,0 +1,78 @@
+#ifndef WARP_UPDATER_H
+#define WARP_UPDATER_H
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mesh_builder.h"
+#include "warp_generator.h"
+
+/**
+ * Consecutive vertices of a mesh in the vertex order of MeshBuilder, which holds the rings one after another.
+ */
+struct WarpVertexSpan {
+    size_t first;
+    std::vector<WarpVertex> vertices;
+};
+
+/**
+ * Follows a generated warp while the projector is moved, on its own thread so interactive adjustment stays at
+ * the frame rate. The projector tangent of every mesh point is kept from the previous pose and is the start of
+ * the search for the next one, so a small nudge takes a step or two per point. Only rings with a point that moved
+ * are handed over, to be written into the current vertex buffer in place. Poses arriving while a pose is solved
+ * are collected into the next one.
+ *
+ * The generated points stay offset by the configured projector position, the view is not moved along with the
+ * projector anymore.
+ */
+class WarpUpdater {
+
+public:
+    WarpUpdater();
+    ~WarpUpdater();
+
+    // the configured geometry the current mesh was generated with
+    bool start(const WarpGeometry &geometry);
+    void stop();
+
+    // a reloaded config, the pose is reset to it
+    void setGeometry(const WarpGeometry &geometry);
+    // projector position, and rotation in radians added to the configured one
+    void setPose(const glm::vec3 &position, const glm::vec3 &rotation);
+    // the mesh was replaced by one generated at the configured pose, the next update covers the whole difference
+    void meshReplaced();
+
+    // the rings that changed since the last call, never blocks
+    bool takeUpdate(std::vector<WarpVertexSpan> *spans);
+
+private:
+    void run();
+    void update(const WarpGeometry &posed, const WarpGeometry &configured);
+
+    WarpGenerator generator_;
+
+    // solver state, only used on the worker thread
+    std::vector<glm::dvec2> tangents_;
+    std::vector<glm::vec3> uvs_;
+    std::vector<glm::vec2> configured_points_;
+    std::vector<glm::vec2> uploaded_points_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    WarpGeometry geometry_;
+    glm::vec3 position_;
+    glm::vec3 rotation_;
+    bool changed_;
+    bool reset_;
+    bool replaced_;
+    std::vector<WarpVertexSpan> spans_;
+
+    std::thread thread_;
+    bool running_;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef X11_SOURCE_H
+#define X11_SOURCE_H
+
+#include <vector>
+
+#include <X11/Xlib.h>
+
+#include "frame_source.h"
+#include "screen_capture.h"
+#include "damage_tracker.h"
+
+/**
+ * Captures a region of the X root window on a dedicated X connection, with XGetImage.
+ * If the damage threshold is set only changed rows are read back.
+ */
+class X11Source : public FrameSource {
+
+public:
+    explicit X11Source(const FrameSourceSettings &settings);
+    ~X11Source() override;
+
+    bool open() override;
+    void close() override;
+    void waitForFrame(double timeout_seconds) override;
+
+    const char *name() const override;
+    int width() const override;
+    int height() const override;
+    PixelFormat::Format format() const override;
+
+protected:
+    X11Source(const FrameSourceSettings &settings, bool shared_memory);
+
+    Result acquireFrame(SourceFrame *frame) override;
+
+private:
+    XImage *grabDirtyRows();
+
+    FrameSourceSettings settings_;
+    bool shared_memory_;
+
+    Display *display_;
+    ScreenCapture *capture_;
+    DamageTracker *damage_;
+    std::vector<Rect> dirty_;
+};
+
+/**
+ * X11Source reading through the MIT-SHM extension, falls back to XGetImage if the server does not support it.
+ */
+class ShmSource : public X11Source {
+
+public:
+    explicit ShmSource(const FrameSourceSettings &settings);
+
+    const char *name() const override;
+};
+
+#endif
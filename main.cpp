@@ -6,40 +6,81 @@
 // GL stuff
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-// X11
-#include <X11/Xlib.h>
-#include <X11/Xmu/WinUtil.h>
 // Include GLM
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
-#include "inc/shader.h"
 #include "inc/json11.hpp"
 #include "inc/input_parser.h"
 #include "inc/texture.h"
 #include "inc/file_io.h"
+#include "inc/capture_thread.h"
+#include "inc/texture_streamer.h"
+#include "inc/latency_tracker.h"
+#include "inc/warp_mesh.h"
+#include "inc/mesh_reloader.h"
+#include "inc/warp_lut.h"
+#include "inc/view_transform.h"
+#include "inc/warp_index.h"
+#include "inc/warp_generator.h"
+#include "inc/warp_updater.h"
+#include "inc/renderer.h"
+#include "inc/frame_output.h"
 
 // gl globals
 GLFWwindow *glfw_window;
-Display *display;
-Window root_window;
-XImage *image;
+CaptureThread *capture_thread;
+TextureStreamer *texture_streamer;
+LatencyTracker *latency_tracker;
+WarpLut *warp_lut;
+WarpIndex *pointer_index;
+WarpGenerator *warp_generator;
+WarpUpdater *warp_updater;
+FrameOutput *frame_output;
 
 int SCREEN_WIDTH = (int) 1200;
 int SCREEN_HEIGHT = (int) 1000;
 
 bool vsync = false;
 bool capture_flag = false;
+bool capture_shm = true;
+std::string capture_source;
+std::string capture_source_file;
+std::string capture_record_file;
+bool replay_realtime = true;
+double capture_fps = 0.0;
+double render_fps = 0.0;
+TextureStreamer::Mode upload_mode = TextureStreamer::PBO;
+bool lut_warp = false;
+bool lean_render = false;
+bool edge_aa = false;
+std::string output_path;
+float damage_threshold = 0.5f;
+std::string latency_file;
+
+// capture region, taken from the model config
+int capture_x = 420;
+int capture_y = 0;
+int capture_width = 0;
+int capture_height = 0;
+int capture_downscale = 1;
 bool show_points = false;
 bool show_polys = false;
 bool paused = false;
 bool running = true;
 bool print_fps = true;
+bool optimize_mesh = false;
+bool watch_files = true;
+bool generate_mesh = false;
 
-int triangle_count;
-GLuint vtx_buffer;
-GLuint tex_buffer;
+WarpMesh warp_mesh;
+Renderer renderer;
+MeshReloader mesh_reloader;
 
 float move_factor = 0.0001f;
 float rotation_factor = 0.0001f;
@@ -48,6 +89,7 @@ glm::vec3 model_rotation(0.0f, 0.0f, 0.00f);
 glm::mat4 MVP;
 
 json11::Json config;
+std::string config_file;
 std::string mesh_file;
 std::string tex_file;
 std::string texture_image;
@@ -58,17 +100,18 @@ void parseCommandLineArgs(int argc, char *argv[]);
 
 bool initializeGLContext(bool show_polys, bool with_vsync);
 
-GLuint init_dynamic_texture(Display *dis, Window win, XImage *image);
+GLuint init_capture_texture(CaptureThread *capture, TextureStreamer *streamer);
+bool fitCaptureTexture(int width, int height, GLuint *texture);
 
 void loadTransformationValues();
 
 void calculateView(glm::vec3, glm::vec3);
 
-GLuint setup_vertices(const char *filepath, int *triangle_count);
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-GLuint setup_tex_coords(const char *filepath);
+void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
 
-void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+void framebufferSizeCallback(GLFWwindow *window, int width, int height);
 
 void handleFramewiseKeyInput();
 
@@ -76,6 +119,8 @@ bool loadConfig(const std::string &config);
 
 void parseConfig();
 
+void applyProjectorPosition();
+
 /**
  * main
  */
@@ -91,31 +136,71 @@ int main(int argc, char *argv[])
     glBindVertexArray(vertex_array_id);
 
     // load shaders
-    GLuint program_id = Shader::loadShaders("shader/simple.vert", "shader/simple.frag");
-    GLint matrix_id = glGetUniformLocation(program_id, "MVP");
+    // the renderer sets up the depth test, the edge antialiased shaders replace multisampling in the lean mode
+    if (edge_aa)
+        renderer.init("shader/edge_aa.vert", "shader/edge_aa.frag", !lean_render);
+    else
+        renderer.init("shader/simple.vert", "shader/simple.frag", !lean_render);
     std::cout << std::endl;
 
     GLuint tex;
     if (capture_flag) {
-        tex = init_dynamic_texture(display, root_window, image);
+        capture_thread = new CaptureThread();
+        texture_streamer = new TextureStreamer();
+        tex = init_capture_texture(capture_thread, texture_streamer);
     }
     else {
         tex = Texture::loadBMP(texture_image.c_str());
         std::cout << std::endl;
     }
 
-    GLint tex_id = glGetUniformLocation(program_id, "myTextureSampler");
+    if (!latency_file.empty()) {
+        latency_tracker = new LatencyTracker();
+        latency_tracker->init();
+    }
 
     calculateView(model_position, model_rotation);
     loadTransformationValues();
+    mesh_reloader.start(mesh_file, tex_file, config_file, optimize_mesh, watch_files, generate_mesh);
+
+    if (lut_warp) {
+        int framebuffer_width, framebuffer_height;
+        glfwGetFramebufferSize(glfw_window, &framebuffer_width, &framebuffer_height);
+        warp_lut = new WarpLut();
+        if (!warp_lut->init(framebuffer_width, framebuffer_height)) {
+            std::cout << "Info: Lookup warp is not available. Using mesh!" << std::endl;
+            delete warp_lut;
+            warp_lut = nullptr;
+        }
+    }
+
+    if (!output_path.empty()) {
+        // rendered offscreen like the window would have been, the window only shows the result
+        int framebuffer_width, framebuffer_height;
+        glfwGetFramebufferSize(glfw_window, &framebuffer_width, &framebuffer_height);
+        frame_output = new FrameOutput();
+        if (!frame_output->init(output_path, framebuffer_width, framebuffer_height, warp_lut || lean_render ? 0 : 4,
+                                !warp_lut && !lean_render)) {
+            std::cout << "Info: Output is not available. Rendering to the window only!" << std::endl;
+            delete frame_output;
+            frame_output = nullptr;
+        }
+    }
 
     // main loop
     double last_time = glfwGetTime();
     int num_frames = 0;
+    auto render_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(render_fps > 0.0 ? 1.0 / render_fps : 0.0));
+    auto next_render = std::chrono::steady_clock::now();
+    unsigned long uploaded_sequence = 0;
+    std::vector<WarpVertexSpan> updated_spans;
     while (running && glfwWindowShouldClose(glfw_window) == 0) {
 
-        // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Clear the screen, the lookup warp writes every pixel anyway
+        if (frame_output)
+            frame_output->bind();
+        renderer.beginFrame(!warp_lut);
         if (!paused) {
 
             ///print render time per frame
@@ -123,81 +208,166 @@ int main(int argc, char *argv[])
                 ++num_frames;
                 double current_time = glfwGetTime();
                 if (current_time - last_time >= 1.0) {
-                    std::cout << "ms/frame: " << (1000.0 / double(num_frames)) << std::endl;
+                    std::cout << "ms/frame: " << (1000.0 / double(num_frames));
+                    if (!warp_lut)
+                        std::cout << ", draw calls/frame: " << renderer.callCount();
+                    std::cout << std::endl;
+                    if (capture_flag && capture_thread->isDirect()) {
+                        const FrameSourceStats &stats = capture_thread->source()->stats();
+                        std::cout << "capture: " << stats.acquired << " frames uploaded in place, " << stats.unchanged
+                                  << " unchanged" << std::endl;
+                    } else if (capture_flag) {
+                        FrameRing &ring = capture_thread->ring();
+                        std::cout << "capture: " << ring.publishedCount() << " frames, " << ring.droppedCount()
+                                  << " dropped, " << ring.reusedCount() << " reused" << std::endl;
+                    }
+                    if (frame_output)
+                        std::cout << "output: " << frame_output->writtenCount() << " frames, "
+                                  << frame_output->droppedCount() << " dropped" << std::endl;
+                    if (latency_tracker)
+                        latency_tracker->printSummary();
                     num_frames = 0;
                     last_time += 1.0;
                 }
             }
 
-            /// capture if set true
-            if (capture_flag) {
-                // get screenshot
-                image = XGetImage(display, root_window, 420, 0, SCREEN_HEIGHT, SCREEN_HEIGHT, AllPlanes, ZPixmap);
-                //image = XGetImage(display, root_window, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, AllPlanes, ZPixmap);
-                if (!image)
-                    printf("Unable to create image...\n");
+            if (latency_tracker)
+                latency_tracker->beginFrame();
+
+            if (capture_flag && capture_thread->isDirect()) {
+                // uploaded straight from the memory of the producer, which leaves the frame alone until released
+                SourceFrame source_frame;
+                Frame timing;
+                if (capture_thread->acquireDirect(&source_frame, &timing)) {
+                    fitCaptureTexture(source_frame.width, source_frame.height, &tex);
+                    if (latency_tracker)
+                        latency_tracker->uploadStarted();
+                    texture_streamer->upload(source_frame.pixels, source_frame.width, source_frame.height,
+                                             source_frame.stride, source_frame.format);
+                    // a producer following the protocol never writes the slot in use. A torn frame is shown until
+                    // the next one but not counted as uploaded.
+                    if (capture_thread->releaseDirect() && latency_tracker)
+                        latency_tracker->frameUploaded(timing);
+                }
+            } else if (capture_flag) {
+                // take the newest captured frame, keep the current texture if nothing new arrived
+                const Frame *frame = capture_thread->ring().acquire();
+                if (frame) {
+                    // dirty regions only describe the change to the previous frame, after a drop upload everything
+                    bool partial = !frame->full && frame->sequence == uploaded_sequence + 1;
+                    if (fitCaptureTexture(frame->width, frame->height, &tex))
+                        partial = false;
+                    if (latency_tracker)
+                        latency_tracker->uploadStarted();
+                    texture_streamer->upload(frame->pixels.data(), frame->width, frame->height, frame->stride,
+                                             frame->format, partial ? &frame->dirty : nullptr);
+                    uploaded_sequence = frame->sequence;
+                    if (latency_tracker)
+                        latency_tracker->frameUploaded(*frame);
+                }
             }
-
-            // use shader
-            glUseProgram(program_id);
-
-            // send transformations to shader
-            glUniformMatrix4fv(matrix_id, 1, GL_FALSE, &MVP[0][0]);
-
-            /**
-             * specify vertex arrays of vertices and uv's
-             * draw finally
-             */
-            if (capture_flag) {
-                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCREEN_HEIGHT, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE,
-                                image->data);
-                glUniform1i(tex_id, 0);
-            } else if (!capture_flag) {
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, tex);
-                glUniform1i(tex_id, 0);
+            renderer.setTexture(tex);
+
+            // reloaded files were built in the background, stream them in and swap once complete
+            WarpMeshData reloaded_mesh;
+            if (mesh_reloader.takeMesh(&reloaded_mesh))
+                warp_mesh.stage(std::move(reloaded_mesh));
+            if (warp_mesh.continueStaging()) {
+                if (warp_updater)
+                    warp_updater->meshReplaced();
+                // lookups follow the mesh that is drawn, not the one still being staged
+                WarpMeshData drawn_mesh;
+                if (pointer_index && warp_mesh.copyData(&drawn_mesh))
+                    pointer_index->setMesh(drawn_mesh);
             }
 
-            // specify vertex arrays of vertices and uv's
-            glEnableVertexAttribArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, vtx_buffer);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
-
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, tex_buffer);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *) 0);
+            json11::Json reloaded_config;
+            if (mesh_reloader.takeConfig(&reloaded_config)) {
+                // the operator's adjustment only gives way to a projector that was changed in the file
+                bool projector_changed = reloaded_config["projector"] != config["projector"];
+                config = reloaded_config.object_items();
+                if (projector_changed) {
+                    applyProjectorPosition();
+                    if (warp_updater)
+                        model_rotation = glm::vec3(0.0f);
+                }
+                WarpGeometry geometry;
+                if (warp_updater && WarpGenerator::parse(config, &geometry)) {
+                    // the mesh is generated again at the configured pose, a kept adjustment is solved on top of it
+                    warp_updater->setGeometry(geometry);
+                    if (projector_changed)
+                        MVP = ViewTransform::mvp(model_position, model_rotation);
+                }
+                calculateView(model_position, model_rotation);
+            }
 
-            if (show_points)
-                glDrawArrays(GL_POINTS, 0, triangle_count * 3);
-            else if (!show_points)
-                glDrawArrays(GL_TRIANGLES, 0, triangle_count * 3);
+            // rings moved by a projector nudge are written into the current vertex buffer in place
+            if (warp_updater && !warp_mesh.isStaging() && warp_updater->takeUpdate(&updated_spans)) {
+                for (const WarpVertexSpan &span : updated_spans) {
+                    warp_mesh.updateVertices(span.first, span.vertices.data(), span.vertices.size());
+                    if (pointer_index)
+                        pointer_index->updateVertices(span.first, span.vertices.data(), span.vertices.size());
+                }
+            }
 
+            if (warp_lut) {
+                // baked again only after the MVP or the mesh changed
+                warp_lut->update(warp_mesh, MVP);
+                warp_lut->draw(tex);
+            } else {
+                // draw the indexed mesh, the program, MVP and texture are only set again after a change
+                renderer.setView(MVP);
+                renderer.draw(warp_mesh, show_points);
+            }
 
-            // draw
-            glDisableVertexAttribArray(0);
-            glDisableVertexAttribArray(1);
+            if (latency_tracker)
+                latency_tracker->drawSubmitted();
 
-            // important otherwise memory will be full soon
-            if (capture_flag) {
-                XDestroyImage(image);
-            }
+            if (frame_output)
+                frame_output->finishFrame();
 
             // Swap buffers
             glfwSwapBuffers(glfw_window);
+
+            if (latency_tracker)
+                latency_tracker->endFrame();
             glfwPollEvents();
 
             handleFramewiseKeyInput();
+
+            // limit render rate independently of the capture rate
+            if (render_fps > 0.0) {
+                next_render += render_interval;
+                auto now = std::chrono::steady_clock::now();
+                if (next_render < now)
+                    next_render = now;
+                std::this_thread::sleep_until(next_render);
+            }
         }
     }
 
     // Cleanup VBO and shader
-    glDeleteBuffers(1, &vtx_buffer);
-    glDeleteBuffers(1, &tex_buffer);
-    glDeleteProgram(program_id);
-    glDeleteTextures(1, &tex);
+    mesh_reloader.stop();
+    if (warp_updater)
+        warp_updater->stop();
+    warp_mesh.release();
+    renderer.release();
+    delete frame_output;
+    if (!capture_flag)
+        glDeleteTextures(1, &tex);
     glDeleteVertexArrays(1, &vertex_array_id);
 
-    XCloseDisplay(display);
+    if (latency_tracker) {
+        latency_tracker->printSummary();
+        latency_tracker->writeCSV(latency_file);
+        delete latency_tracker;
+    }
+    delete warp_lut;
+    delete pointer_index;
+    delete warp_updater;
+    delete warp_generator;
+    delete texture_streamer;
+    delete capture_thread;
 
     // Close OpenGL glfw_window and terminate GLFW
     glfwTerminate();
@@ -215,20 +385,40 @@ void print_help()
     std::cout << "  -poly              [show mesh polylines]" << std::endl;
     std::cout << "  -vsync             [enable vsync]" << std::endl;
     std::cout << "  -capture           [enable capturing" << std::endl;
+    std::cout << "  -noshm             [capture via XGetImage instead of MIT-SHM]" << std::endl;
+    std::cout << "  -source <type>     [frame source: shm (default), x11, file, ring or synthetic]" << std::endl;
+    std::cout << "  -source-file <file> [frames of the file source, shared memory name of the ring]" << std::endl;
+    std::cout << "  -replay-rate <rate> [file source rate: original (default) or max]" << std::endl;
+    std::cout << "  -record <file>     [record captured frames to a frame sequence file]" << std::endl;
+    std::cout << "  -capture-fps <n>   [limit capture rate, unlimited by default]" << std::endl;
+    std::cout << "  -render-fps <n>    [limit render rate, unlimited by default]" << std::endl;
+    std::cout << "  -upload <mode>     [capture upload mode: pbo (default) or sync]" << std::endl;
+    std::cout << "  -warp <mode>       [warp mode: mesh (default) or lut]" << std::endl;
+    std::cout << "  -lean              [render without depth buffer and multisampling]" << std::endl;
+    std::cout << "  -edge-aa           [antialias the mesh border in the shader, for -lean]" << std::endl;
+    std::cout << "  -output <file>     [also write frames as raw BGRA to a file, pipe or - for stdout]" << std::endl;
+    std::cout << "  -nodamage          [capture every frame instead of tracking changes]" << std::endl;
+    std::cout << "  -damage-threshold <f> [changed fraction (0, 1] above which full frames are captured]" << std::endl;
+    std::cout << "  -latency <file>    [track capture to present latency, written as csv on exit]" << std::endl;
     std::cout << "  -h                 [print this dialog]" << std::endl;
     std::cout << "  -config <file>     [specify model config file]" << std::endl;
     std::cout << "  -mesh <file>       [specify mesh file]" << std::endl;
     std::cout << "  -texcoords <file>  [specify texture coordinate file]" << std::endl;
     std::cout << "  -texture <file>    [specify texture image]" << std::endl;
+    std::cout << "  -optimize-mesh     [reorder the mesh for the vertex cache]" << std::endl;
+    std::cout << "  -nowatch           [only reload mesh and config files on request]" << std::endl;
+    std::cout << "  -generate          [generate the mesh from the geometry in the model config]" << std::endl;
     std::cout << std::endl;
 
     std::cout << "Controls:" << std::endl;
     std::cout << "  general:" << std::endl;
     std::cout << "    esc - exit glwarp" << std::endl;
-    std::cout << "    r - reload transformation settings" << std::endl;
+    std::cout << "    r - reload mesh, texture coordinates and config" << std::endl;
     std::cout << "    i - print mesh position and rotation information" << std::endl;
     std::cout << "    x - reset mesh position and rotation" << std::endl;
     std::cout << "    f - activate continuous fps output" << std::endl;
+    std::cout << "    t - write latency csv (with -latency)" << std::endl;
+    std::cout << "    left click - print the source coordinate shown under the pointer" << std::endl;
     std::cout << "  mesh:" << std::endl;
     std::cout << "    w - increase distance to mesh" << std::endl;
     std::cout << "    s - decrease distance to mesh" << std::endl;
@@ -249,10 +439,106 @@ void parseCommandLineArgs(int argc, char *argv[])
 {
     InputParser input_parser(argc, argv);
 
+    // frames written to stdout must not be mixed with anything printed
+    if (input_parser.cmdOptionExists("-output")) {
+        output_path = input_parser.getCmdOption("-output");
+        if (output_path == "-")
+            FrameOutput::takeStdout();
+        if (output_path == "")
+            std::cout << "Info: There was no output file specified. Rendering to the window only!" << std::endl;
+    }
+
     print_fps = input_parser.cmdOptionExists("-fps");
     show_polys = input_parser.cmdOptionExists("-poly");
     vsync = input_parser.cmdOptionExists("-vsync");
+    optimize_mesh = input_parser.cmdOptionExists("-optimize-mesh");
+    watch_files = !input_parser.cmdOptionExists("-nowatch");
+    generate_mesh = input_parser.cmdOptionExists("-generate");
+    if (generate_mesh && optimize_mesh) {
+        // updates after projector nudges are written in place and rely on the generated vertex order
+        std::cout << "Info: A generated mesh is not optimised. Ignoring -optimize-mesh!" << std::endl;
+        optimize_mesh = false;
+    }
     capture_flag = input_parser.cmdOptionExists("-capture");
+    capture_shm = !input_parser.cmdOptionExists("-noshm");
+    capture_source = capture_shm ? "shm" : "x11";
+
+    if (input_parser.cmdOptionExists("-source")) {
+        std::string opt = input_parser.getCmdOption("-source");
+        if (opt != "") {
+            capture_source = opt;
+            capture_flag = true;
+        } else {
+            std::cout << "Info: There was no frame source specified. Using " << capture_source << "!" << std::endl;
+        }
+    }
+
+    if (input_parser.cmdOptionExists("-source-file"))
+        capture_source_file = input_parser.getCmdOption("-source-file");
+
+    if (input_parser.cmdOptionExists("-replay-rate")) {
+        std::string opt = input_parser.getCmdOption("-replay-rate");
+        if (opt == "original" || opt == "max") {
+            replay_realtime = opt == "original";
+        } else {
+            std::cout << "Info: Unknown replay rate '" << opt << "'. Using original!" << std::endl;
+        }
+    }
+
+    if (input_parser.cmdOptionExists("-record")) {
+        capture_record_file = input_parser.getCmdOption("-record");
+        capture_flag = true;
+    }
+
+    if (input_parser.cmdOptionExists("-capture-fps"))
+        capture_fps = std::atof(input_parser.getCmdOption("-capture-fps").c_str());
+
+    if (input_parser.cmdOptionExists("-render-fps"))
+        render_fps = std::atof(input_parser.getCmdOption("-render-fps").c_str());
+
+    if (input_parser.cmdOptionExists("-damage-threshold")) {
+        std::string opt = input_parser.getCmdOption("-damage-threshold");
+        float threshold = (float) std::atof(opt.c_str());
+        // 0 would turn tracking off, which is what -nodamage is for
+        if (threshold > 0.0f && threshold <= 1.0f) {
+            damage_threshold = threshold;
+        } else {
+            std::cout << "Info: Damage threshold '" << opt << "' is not in (0, 1]. Using " << damage_threshold << "!"
+                      << std::endl;
+        }
+    }
+
+    if (input_parser.cmdOptionExists("-nodamage"))
+        damage_threshold = 0.0f;
+
+    if (input_parser.cmdOptionExists("-latency")) {
+        latency_file = input_parser.getCmdOption("-latency");
+        if (latency_file == "") {
+            latency_file = "latency.csv";
+            std::cout << "Info: There was no latency file specified. Using " << latency_file << "!" << std::endl;
+        }
+    }
+
+    if (input_parser.cmdOptionExists("-upload")) {
+        std::string opt = input_parser.getCmdOption("-upload");
+        if (opt == "sync") {
+            upload_mode = TextureStreamer::SYNC;
+        } else if (opt != "pbo") {
+            std::cout << "Info: Unknown upload mode '" << opt << "'. Using pbo!" << std::endl;
+        }
+    }
+
+    if (input_parser.cmdOptionExists("-warp")) {
+        std::string opt = input_parser.getCmdOption("-warp");
+        if (opt == "lut") {
+            lut_warp = true;
+        } else if (opt != "mesh") {
+            std::cout << "Info: Unknown warp mode '" << opt << "'. Using mesh!" << std::endl;
+        }
+    }
+
+    lean_render = input_parser.cmdOptionExists("-lean");
+    edge_aa = input_parser.cmdOptionExists("-edge-aa");
 
     if(input_parser.cmdOptionExists("-h"))
         print_help();
@@ -317,17 +603,22 @@ void parseCommandLineArgs(int argc, char *argv[])
  * @return
  */
 bool initializeGLContext(bool show_polys, bool with_vsync)
-{ //get x11 client reference
-    display = XOpenDisplay(nullptr);
-    root_window = DefaultRootWindow(display);
-
+{
     // Initialise GLFW
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
         return -1;
     }
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // the lookup warp draws a single fullscreen triangle, multisampling would only cost bandwidth. The lean mode
+    // needs only color, and so does the window of an output, the resolved frame is copied into it.
+    bool color_only = lean_render || !output_path.empty();
+    glfwWindowHint(GLFW_SAMPLES, lut_warp || color_only ? 0 : 4);
+    if (color_only) {
+        // the warp never overlaps itself, a depth and stencil buffer would only be cleared every frame
+        glfwWindowHint(GLFW_DEPTH_BITS, 0);
+        glfwWindowHint(GLFW_STENCIL_BITS, 0);
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
@@ -357,11 +648,11 @@ bool initializeGLContext(bool show_polys, bool with_vsync)
     // input settings
     glfwSetInputMode(glfw_window, GLFW_STICKY_KEYS, GL_TRUE);
     glfwSetKeyCallback(glfw_window, keyCallback);
+    glfwSetMouseButtonCallback(glfw_window, mouseButtonCallback);
+    glfwSetFramebufferSizeCallback(glfw_window, framebufferSizeCallback);
 
     // init GL settings
     glfwSetInputMode(glfw_window, GLFW_STICKY_KEYS, GL_TRUE);
-    glEnable(GL_DEPTH_TEST); // enable depth test
-    glDepthFunc(GL_LESS); // Accept fragment if it closer to the camera than the former one
     glEnable(GL_PROGRAM_POINT_SIZE);
 
     // set show polys flag to show vertice grid
@@ -383,7 +674,7 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         running = false;
 
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
-        loadTransformationValues();
+        mesh_reloader.request();
 
     if (key == GLFW_KEY_1 && action == GLFW_PRESS)
         move_factor /= 10;
@@ -411,8 +702,15 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
             print_fps = true;
     }
 
+    if (key == GLFW_KEY_T && action == GLFW_PRESS && latency_tracker)
+        latency_tracker->dumpCSV(latency_file);
+
     if (key == GLFW_KEY_X && action == GLFW_PRESS) {
-        model_position = glm::vec3(0.0f, 0.0f, 0.0f);
+        // a generated mesh goes back to the configured projector
+        if (warp_updater)
+            applyProjectorPosition();
+        else
+            model_position = glm::vec3(0.0f, 0.0f, 0.0f);
         model_rotation = glm::vec3(0.0f, 0.0f, 0.0f);
         calculateView(model_position, model_rotation);
     }
@@ -429,252 +727,185 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
     }
 }
 
+void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS)
+        return;
+
+    // the index is only built once the pointer is used, from the mesh that is drawn
+    if (!pointer_index) {
+        WarpMeshData data;
+        if (!warp_mesh.copyData(&data))
+            return;
+        pointer_index = new WarpIndex();
+        pointer_index->setMesh(data);
+    }
+
+    // the cursor is in window coordinates, the mesh is rendered in framebuffer pixels
+    int window_width, window_height, framebuffer_width, framebuffer_height;
+    glfwGetWindowSize(window, &window_width, &window_height);
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    double cursor_x, cursor_y;
+    glfwGetCursorPos(window, &cursor_x, &cursor_y);
+    auto x = (float) (cursor_x * framebuffer_width / std::max(window_width, 1));
+    auto y = (float) (cursor_y * framebuffer_height / std::max(window_height, 1));
+
+    pointer_index->setView(MVP, framebuffer_width, framebuffer_height);
+    glm::vec2 uv;
+    if (!pointer_index->query(x, y, &uv)) {
+        std::cout << "INFO: pixel " << x << " " << y << " is outside the mesh" << std::endl;
+        return;
+    }
+
+    std::cout << "INFO: pixel " << x << " " << y << " shows texture coordinate " << uv.x << " " << uv.y;
+    if (capture_flag)
+        std::cout << ", screen pixel " << capture_x + uv.x * capture_width << " " << capture_y + uv.y * capture_height;
+    std::cout << std::endl;
+}
+
+void framebufferSizeCallback(GLFWwindow *window, int width, int height)
+{
+    // a minimised window keeps everything at its last size
+    if (width <= 0 || height <= 0)
+        return;
+
+    glViewport(0, 0, width, height);
+    if (warp_lut)
+        warp_lut->resize(width, height);
+    if (frame_output)
+        frame_output->resize(width, height);
+}
+
 void handleFramewiseKeyInput()
 {
+    // held keys add up, the view is calculated once per frame
+    bool moved = false;
+
     if (glfwGetKey(glfw_window, GLFW_KEY_W) == GLFW_PRESS) {
         model_position.z -= move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_S) == GLFW_PRESS) {
         model_position.z += move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_A) == GLFW_PRESS) {
         model_position.x -= move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_D) == GLFW_PRESS) {
         model_position.x += move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_J) == GLFW_PRESS) {
         model_position.y -= move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_K) == GLFW_PRESS) {
         model_position.y += move_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_H) == GLFW_PRESS) {
         model_rotation.x += rotation_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
 
     if (glfwGetKey(glfw_window, GLFW_KEY_L) == GLFW_PRESS) {
         model_rotation.x -= rotation_factor;
-        calculateView(model_position, model_rotation);
+        moved = true;
     }
+
+    if (moved)
+        calculateView(model_position, model_rotation);
 }
 
 void loadTransformationValues()
 {
-    triangle_count = 0;
-    vtx_buffer = setup_vertices(mesh_file.c_str(), &triangle_count);
-    tex_buffer = setup_tex_coords(tex_file.c_str());
+    warp_mesh.setOptimize(optimize_mesh);
+
+    if (generate_mesh) {
+        // the generator and its threads are created once and kept
+        if (!warp_generator)
+            warp_generator = new WarpGenerator();
+        WarpGeometry geometry;
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec3> uvs;
+        if (!WarpGenerator::parse(config, &geometry) || !warp_generator->generate(geometry, &points, &uvs))
+            return;
+        warp_mesh.build(points, uvs, geometry.rings, geometry.points_per_ring, 0);
+
+        // projector nudges are followed by solving the mesh again instead of moving the view
+        warp_updater = new WarpUpdater();
+        warp_updater->start(geometry);
+        return;
+    }
+
+    // binary meshes carry their texture coordinates
+    if (MeshLoader::isBinary(mesh_file))
+        warp_mesh.loadBinary(mesh_file.c_str());
+    else
+        warp_mesh.load(mesh_file.c_str(), tex_file.c_str());
 }
 
 void calculateView(glm::vec3 model_pos, glm::vec3 model_rot)
 {
-    // projection matrix
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
-
-    // camera matrix
-    glm::mat4 view = glm::lookAt(
-            glm::vec3(0.0, 0.0, 0.0), // camera pos world space
-            glm::vec3(0.0, 0.0, 100.0), // camera lookat
-            glm::vec3(0, 1, 0)  // up-vec
-    );
-
-    // model
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, model_pos);
-    model = glm::translate(model, glm::vec3(-model_pos));
-    model = glm::rotate(model, model_rot.x, glm::vec3(1, 0, 0));
-    model = glm::translate(model, glm::vec3(model_pos));
-
-    // build mvp
-    MVP = projection * view * model;
+    // the model is moved opposite to the projector
+    if (warp_updater) {
+        warp_updater->setPose(-model_pos, model_rot);
+        return;
+    }
+
+    MVP = ViewTransform::mvp(model_pos, model_rot);
 }
 
-GLuint setup_vertices(const char *filepath, int *triangle_count)
+GLuint init_capture_texture(CaptureThread *capture, TextureStreamer *streamer)
 {
-    std::vector<glm::vec3> mesh;
-
-    // setup mesh
-    FileIO::loadFile(filepath, &mesh);
-    // get meta information about calculated
-    auto circle_count = (int) mesh.back().x;
-    auto points_per_circle = (int) mesh.back().y;
-    auto point_count = (int) mesh.back().z;
-//    std::cout << "circle count: " << circle_count << " points_per_circle: " << points_per_circle << std::endl;
-
-    mesh.pop_back();
-    mesh.pop_back();
-    //mapVecToRange(&mesh);
-//    std::cout << "blue size: " << mesh.size() << " read point count: " << point_count << std::endl;
-    if (mesh.size() != point_count) {
-        std::cout << "Warp points do not match" << std::endl;
-        return -1;
+    // without a configured region capture a square of the screen height
+    if (capture_width <= 0 || capture_height <= 0) {
+        capture_width = SCREEN_HEIGHT;
+        capture_height = SCREEN_HEIGHT;
     }
 
-    std::vector<glm::vec3> mesh_vec;
-    // create mesh
-    for (int circle_idx = 0; circle_idx < circle_count; ++circle_idx) {
-        if (circle_idx == 0) {
-            for (int t = 1; t < points_per_circle + 1; ++t) {
-                // start triangles around center
-                //std::cout << 0 << " " << t << " " << 1 + (t % points_per_circle) << std::endl;
-
-                int i1 = 0;
-                int i2 = t;
-                int i3 = 1 + (t % points_per_circle);
-                mesh_vec.push_back(mesh[i1]);
-                mesh_vec.push_back(mesh[i2]);
-                mesh_vec.push_back(mesh[i3]);
-                *triangle_count += 1;
-            }
-        } else {
-            int start_point = circle_idx * points_per_circle - (points_per_circle - 1);
-            for (int idx = 0; idx < points_per_circle; ++idx) {
-                int i1 = start_point + idx;
-                int i2 = start_point + idx + points_per_circle;
-                int i3 = start_point + (idx + 1) % points_per_circle;
-                mesh_vec.push_back(mesh[i1]);
-                mesh_vec.push_back(mesh[i2]);
-                mesh_vec.push_back(mesh[i3]);
-                //std::cout << i1<< " " << i2 << " " << i3 << std::endl;
-                int i4 = start_point + (idx + 1) % points_per_circle;
-                int i5 = start_point + idx + points_per_circle;
-                int i6 = start_point + ((idx + 1) % points_per_circle) + points_per_circle;
-                mesh_vec.push_back(mesh[i4]);
-                mesh_vec.push_back(mesh[i5]);
-                mesh_vec.push_back(mesh[i6]);
-                //std::cout << i4 << " " << i5<< " " << i6 << std::endl;
-                *triangle_count += 2;
-            }
-        }
+    FrameSourceSettings settings;
+    settings.x = capture_x;
+    settings.y = capture_y;
+    settings.width = capture_width;
+    settings.height = capture_height;
+    settings.damage_threshold = damage_threshold;
+    settings.path = capture_source_file;
+    settings.realtime = replay_realtime;
+
+    // start capturing, frames arrive asynchronously through the capture ring
+    capture->setDownscale(capture_downscale);
+    capture->setRecordPath(capture_record_file);
+    if (!capture->start(FrameSource::create(capture_source, settings), capture_fps)) {
+        return 0;
     }
 
-    // create buffers
-    GLuint vertex_buffer;
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, mesh_vec.size() * sizeof(glm::vec3), &mesh_vec[0], GL_STATIC_DRAW);
-    return vertex_buffer;
-
-
-}
-
-GLuint setup_tex_coords(const char *filepath)
-{
-
-    std::vector<glm::vec3> uv_coords;
-    // setup mesh
-    FileIO::loadFile(filepath, &uv_coords);
-    // get meta information about calculated
-    auto circle_count = (int) uv_coords.back().x;
-    auto points_per_circle = (int) uv_coords.back().y;
-    auto point_count = (int) uv_coords.back().z;
-    uv_coords.pop_back();
-    uv_coords.pop_back();
-
-//    std::cout << "red size: " << uv_coords.size() << " read point count: " << point_count << std::endl;
-    //mapVecToRange(&uv_coords);
-    std::vector<glm::vec2> tex_vec;
-    for (int circle_idx = 0; circle_idx < circle_count; ++circle_idx) {
-        if (circle_idx == 0) {
-            for (int t = 1; t < points_per_circle + 1; ++t) {
-                // start triangles around center
-                //std::cout << 0 << " " << t << " " << 1 + (t % points_per_circle) << std::endl;
-                int i1 = 0;
-                int i2 = t;
-                int i3 = 1 + (t % points_per_circle);
-
-                //float u = mapToRange(uv_coords[i1].x, min_pos_x, max_pos_x, 0.0f, 1.0f);
-                float u = uv_coords[i1].x;
-                float v = uv_coords[i1].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i2].x;
-                v = uv_coords[i2].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i3].x;
-                v = uv_coords[i3].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-            }
-        } else {
-            int start_point = circle_idx * points_per_circle - (points_per_circle - 1);
-            for (int idx = 0; idx < points_per_circle; ++idx) {
-                int i1 = start_point + idx;
-                int i2 = start_point + idx + points_per_circle;
-                int i3 = start_point + (idx + 1) % points_per_circle;
-                float u = uv_coords[i1].x;
-                float v = uv_coords[i1].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i2].x;
-                v = uv_coords[i2].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i3].x;
-                v = uv_coords[i3].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                //std::cout << i1<< " " << i2 << " " << i3 << std::endl;
-                int i4 = start_point + (idx + 1) % points_per_circle;
-                int i5 = start_point + idx + points_per_circle;
-                int i6 = start_point + ((idx + 1) % points_per_circle) + points_per_circle;
-                u = uv_coords[i4].x;
-                v = uv_coords[i4].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i5].x;
-                v = uv_coords[i5].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-
-                u = uv_coords[i6].x;
-                v = uv_coords[i6].y;
-                tex_vec.emplace_back(glm::vec2(u, v));
-                //std::cout << i4 << " " << i5<< " " << i6 << std::endl;
-            }
-        }
+    // create the texture the captured frames are streamed into
+    if (!streamer->init(capture->width(), capture->height(), upload_mode)) {
+        return 0;
     }
 
-    GLuint uv_buffer;
-    glGenBuffers(1, &uv_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uv_buffer);
-    glBufferData(GL_ARRAY_BUFFER, tex_vec.size() * sizeof(glm::vec2), &tex_vec[0], GL_STATIC_DRAW);
-    return uv_buffer;
+    return streamer->texture();
 }
 
-GLuint init_dynamic_texture(Display *dis, Window win, XImage *image)
+bool fitCaptureTexture(int width, int height, GLuint *texture)
 {
-    // CREATE AND INIT DYNAMIC TEXTURE FROM SCREEN
-    GLuint dynamic_tex;
-    // get initial image
-//    image = XGetImage(dis, win, 420, 0, SCREEN_HEIGHT, SCREEN_HEIGHT, AllPlanes, ZPixmap);
-    std::cout << "working" << std::endl;
-    image = XGetImage(display, root_window, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, AllPlanes, ZPixmap);
-
-    // create and bind new texture
-    glGenTextures(0, &dynamic_tex);
-    glBindTexture(GL_TEXTURE_2D, dynamic_tex);
-
-    // specify 2D texture image
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCREEN_HEIGHT, SCREEN_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->data);
-    //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->data);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // a source may come back at another size, e.g. a restarted ring producer
+    if (width == texture_streamer->width() && height == texture_streamer->height())
+        return false;
 
-    return dynamic_tex;
+    texture_streamer->init(width, height, upload_mode);
+    *texture = texture_streamer->texture();
+    renderer.invalidate();
+    return true;
 }
 
 bool loadConfig(const std::string &file_name)
@@ -702,16 +933,48 @@ bool loadConfig(const std::string &file_name)
     std::cout << std::endl;
 
     config = json.object_items();
+    config_file = file_name;
 
     return true;
 }
 
 void parseConfig()
 {
-    float projector_x = (float) config["projector"]["position"]["x"].number_value();
-    float projector_y = (float) config["projector"]["position"]["y"].number_value();
-    float projector_z = (float) config["projector"]["position"]["z"].number_value();
+    applyProjectorPosition();
+
+    // by default capture the centered square of the projector screen
+    int screen_width = config["projector"]["screen"]["w"].int_value();
+    int screen_height = config["projector"]["screen"]["h"].int_value();
+    if (screen_width > 0 && screen_height > 0) {
+        capture_x = std::max((screen_width - screen_height) / 2, 0);
+        capture_y = 0;
+        capture_width = std::min(screen_width, screen_height);
+        capture_height = capture_width;
+    }
 
-    glm::vec3 projector_position(-1 * projector_x, -1 * projector_y, -1 * projector_z);
-    model_position = projector_position;
+    // explicit capture region
+    const json11::Json &capture = config["capture"];
+    if (capture["region"].is_object()) {
+        capture_x = capture["region"]["x"].int_value();
+        capture_y = capture["region"]["y"].int_value();
+        capture_width = capture["region"]["w"].int_value();
+        capture_height = capture["region"]["h"].int_value();
+    }
+
+    // downscale factor, either given directly or derived from the target texture size
+    capture_downscale = capture["downscale"].int_value();
+    int texture_width = capture["texture"]["w"].int_value();
+    if (capture_downscale < 1 && texture_width > 0)
+        capture_downscale = capture_width / texture_width;
+    capture_downscale = std::max(capture_downscale, 1);
+
+    if (texture_width > 0 && texture_width != capture_width / capture_downscale) {
+        std::cout << "Info: Capture texture width " << texture_width << " is not an integer fraction of the region. "
+                  << "Using " << capture_width / capture_downscale << "!" << std::endl;
+    }
+}
+
+void applyProjectorPosition()
+{
+    model_position = ViewTransform::modelPosition(config);
 }
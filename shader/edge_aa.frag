@@ -0,0 +1,20 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+in float Edge;
+
+// Ouput data
+out vec4 color;
+
+// Values that stay constant for the whole mesh.
+uniform sampler2D myTextureSampler;
+
+void main() {
+	// fades to black over the last pixel inside the border of the mesh instead of multisampling it. The clear
+	// color is black, so no blending is needed.
+	float coverage = clamp(Edge / max(fwidth(Edge), 1e-6), 0.0, 1.0);
+
+	// same orientation and alpha handling as simple.frag
+	color = vec4(texture(myTextureSampler, vec2(UV.x, 1.0f - UV.y)).rgb * coverage, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+// Input vertex data, the layout of simple.vert and the edge attribute of WarpMesh
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+// zero on the border of the mesh, one everywhere inside
+layout(location = 2) in float vertexEdge;
+
+// Output data ; will be interpolated for each fragment.
+out vec2 UV;
+// zero exactly on the border of the mesh and rising linearly across the triangles along it
+out float Edge;
+
+// Values that stay constant for the whole mesh.
+uniform mat4 MVP;
+
+void main(){
+    gl_PointSize = 8.0f;
+
+	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
+	UV = vertexUV;
+	Edge = vertexEdge;
+}
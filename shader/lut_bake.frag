@@ -0,0 +1,11 @@
+#version 330 core
+
+// Interpolated texture coordinate of the warp mesh
+in vec2 UV;
+
+// Ouput data, the lookup texture is cleared to -1 where the mesh does not cover the screen
+out vec2 lookup;
+
+void main() {
+	lookup = UV;
+}
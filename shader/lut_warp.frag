@@ -0,0 +1,21 @@
+#version 330 core
+
+// Ouput data
+out vec4 color;
+
+// baked texture coordinate per output pixel and the texture they refer to
+uniform sampler2D lookupSampler;
+uniform sampler2D myTextureSampler;
+
+void main() {
+	vec2 UV = texelFetch(lookupSampler, ivec2(gl_FragCoord.xy), 0).rg;
+
+	// outside the mesh
+	if (UV.x < 0.0) {
+		color = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	// same orientation and alpha handling as simple.frag
+	color = vec4(texture(myTextureSampler, vec2(UV.x, 1.0f - UV.y)).rgb, 1.0);
+}
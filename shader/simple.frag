@@ -12,8 +12,9 @@ uniform sampler2D myTextureSampler;
 void main() {
     // since the texture uv origin is in the lower left corner and the images origin in the upper left
     // we need to flip the UV's y-coordinate
-    // furthermore gl's internal format converts to bgra anyway, therefor . bgra as color output
-	color = texture( myTextureSampler, vec2(UV.x, 1.0f- UV.y)).bgra;
+    // textures are uploaded in their own channel order, so no swizzle is needed. the alpha of captured frames
+    // is undefined (X leaves the padding byte unset), therefor the output is opaque
+	color = vec4(texture( myTextureSampler, vec2(UV.x, 1.0f- UV.y)).rgb, 1.0);
 //	color = texture( myTextureSampler, vec2(UV.x, 1.0f- UV.y)).rgba;
 	//color = vec4(200.0, 0.0, 0.0, 1.0).rgba;
 }
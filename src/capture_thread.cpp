@@ -0,0 +1,357 @@
+#include "../inc/capture_thread.h"
+#include "../inc/downscale.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// a failing source is retried after a pause that doubles with every failure in a row, up to this
+const double MAX_FAILURE_WAIT = 0.25;
+
+}
+
+CaptureThread::CaptureThread()
+        : source_(nullptr),
+          ring_(),
+          downscale_(1),
+          history_(),
+          convert_buffer_(),
+          record_path_(),
+          recorder_(),
+          thread_(),
+          running_(false),
+          capture_interval_(0.0),
+          direct_(false),
+          next_direct_()
+{
+}
+
+CaptureThread::~CaptureThread()
+{
+    stop();
+}
+
+bool CaptureThread::start(FrameSource *source, double capture_fps)
+{
+    stop();
+
+    source_ = source;
+    if (!source_ || !source_->open()) {
+        stop();
+        return false;
+    }
+
+    if (!PixelFormat::isDirect(source_->format())) {
+        std::cout << "Capture: converting " << PixelFormat::name(source_->format()) << " to "
+                  << PixelFormat::name(PixelFormat::directFormat(source_->format())) << " using "
+                  << PixelFormat::kernelName() << std::endl;
+    }
+
+    if (downscale_ > 1) {
+        std::cout << "Capture: downscaling by " << downscale_ << " to " << width() << "x" << height() << " using "
+                  << Downscale::kernelName() << std::endl;
+    }
+
+    if (!record_path_.empty())
+        recorder_.open(record_path_, source_->width(), source_->height(), source_->format());
+
+    capture_interval_ = capture_fps > 0.0 ? 1.0 / capture_fps : 0.0;
+
+    direct_ = source_->framesInPlace() && downscale_ == 1 && record_path_.empty() &&
+              PixelFormat::isDirect(source_->format());
+    if (direct_) {
+        std::cout << "Capture: uploading frames of " << source_->name() << " in place" << std::endl;
+        next_direct_ = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&CaptureThread::run, this);
+    return true;
+}
+
+void CaptureThread::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+
+    if (source_) {
+        const FrameSourceStats &stats = source_->stats();
+        if (stats.acquired > 0) {
+            std::cout << "Capture: " << source_->name() << " acquired " << stats.acquired << " frames in "
+                      << (1000.0 * stats.acquire_seconds / (double) stats.acquired) << " ms/frame, "
+                      << stats.unchanged << " unchanged, " << stats.failed << " failed" << std::endl;
+        }
+        source_->close();
+        delete source_;
+        source_ = nullptr;
+    }
+    history_.clear();
+    recorder_.close();
+    direct_ = false;
+}
+
+void CaptureThread::setDownscale(int factor)
+{
+    downscale_ = factor > 1 ? factor : 1;
+}
+
+void CaptureThread::setRecordPath(const std::string &path)
+{
+    record_path_ = path;
+}
+
+FrameRing &CaptureThread::ring()
+{
+    return ring_;
+}
+
+const FrameSource *CaptureThread::source() const
+{
+    return source_;
+}
+
+bool CaptureThread::isDirect() const
+{
+    return direct_;
+}
+
+int CaptureThread::width() const
+{
+    return source_ ? source_->width() / downscale_ : 0;
+}
+
+int CaptureThread::height() const
+{
+    return source_ ? source_->height() / downscale_ : 0;
+}
+
+bool CaptureThread::acquireDirect(SourceFrame *frame, Frame *timing)
+{
+    if (!direct_)
+        return false;
+
+    // a ring opened again with fewer slots or another format goes through the capture thread from then on
+    if (!source_->framesInPlace() || !PixelFormat::isDirect(source_->format())) {
+        std::cout << "Capture: copying frames of " << source_->name() << " again" << std::endl;
+        direct_ = false;
+        running_ = true;
+        thread_ = std::thread(&CaptureThread::run, this);
+        return false;
+    }
+
+    // the capture rate limit holds here as well
+    auto acquire_time = std::chrono::steady_clock::now();
+    if (acquire_time < next_direct_)
+        return false;
+    if (source_->acquire(frame) != FrameSource::ACQUIRED)
+        return false;
+    if (capture_interval_ > 0.0) {
+        next_direct_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(capture_interval_));
+        if (next_direct_ < acquire_time)
+            next_direct_ = acquire_time;
+    }
+
+    auto acquired_time = std::chrono::steady_clock::now();
+    timing->width = frame->width;
+    timing->height = frame->height;
+    timing->stride = frame->stride;
+    timing->format = frame->format;
+    timing->sequence = source_->stats().acquired;
+    timing->capture_start = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            acquire_time.time_since_epoch()).count();
+    timing->capture_end = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            acquired_time.time_since_epoch()).count();
+    timing->full = true;
+    timing->dirty.clear();
+    return true;
+}
+
+bool CaptureThread::releaseDirect()
+{
+    // the producer leaves the frame alone until it is released, one that did not is counted as torn by the source
+    bool intact = source_->frameIntact();
+    source_->release();
+    return intact;
+}
+
+void CaptureThread::run()
+{
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(capture_interval_));
+    auto next_capture = std::chrono::steady_clock::now();
+
+    SourceFrame source_frame;
+    unsigned long failures = 0;
+    while (running_) {
+        auto acquire_time = std::chrono::steady_clock::now();
+        FrameSource::Result result = source_->acquire(&source_frame);
+
+        // nothing changed: skip copy and upload, just wait for the next change
+        if (result == FrameSource::UNCHANGED) {
+            source_->waitForFrame(capture_interval_ > 0.0 ? capture_interval_ : 0.01);
+            continue;
+        }
+
+        if (result == FrameSource::ACQUIRED) {
+            auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(acquire_time.time_since_epoch());
+            // a torn frame is neither published nor recorded
+            if (publishFrame(source_frame, (uint64_t) timestamp.count()) && recorder_.isOpen())
+                recorder_.write(source_frame, (uint64_t) timestamp.count());
+            source_->release();
+            failures = 0;
+        } else {
+            // reported again each time the pause doubles, so a source that stays broken does not flood the log
+            ++failures;
+            double wait = std::min(0.01 * (double) (1ul << std::min(failures - 1, 10ul)), MAX_FAILURE_WAIT);
+            if (wait < MAX_FAILURE_WAIT || failures % 240 == 0) {
+                std::cout << "Capture: unable to acquire frame from " << source_->name() << ", " << failures
+                          << " failures in a row" << std::endl;
+            }
+            source_->waitForFrame(wait);
+            continue;
+        }
+
+        // unlimited capture rate runs back to back
+        if (capture_interval_ > 0.0) {
+            next_capture += interval;
+            auto now = std::chrono::steady_clock::now();
+            if (next_capture < now)
+                next_capture = now;
+            std::this_thread::sleep_until(next_capture);
+        }
+    }
+}
+
+bool CaptureThread::publishFrame(const SourceFrame &source_frame, uint64_t capture_start)
+{
+    Frame *frame = ring_.writeSlot();
+    copyToSlot(source_frame, frame);
+
+    // a producer process may have overwritten the frame while it was copied, the slot is simply written again
+    if (!source_->frameIntact())
+        return false;
+
+    // published regions are in frame coordinates
+    frame->full = source_frame.full;
+    frame->dirty.clear();
+    for (const Rect &rect : source_frame.dirty)
+        frame->dirty.push_back(Downscale::scaleRect(rect, downscale_, frame->width, frame->height));
+
+    // remember what changed so slots that are several frames behind can be brought up to date
+    DirtyHistory entry;
+    entry.sequence = ring_.publishedCount() + 1;
+    entry.full = source_frame.full;
+    entry.rects = source_frame.dirty;
+    history_.push_back(entry);
+    if ((int) history_.size() > HISTORY_LENGTH)
+        history_.pop_front();
+
+    auto capture_end = std::chrono::steady_clock::now().time_since_epoch();
+    frame->capture_start = capture_start;
+    frame->capture_end = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(capture_end).count();
+    ring_.publish();
+    return true;
+}
+
+void CaptureThread::copyToSlot(const SourceFrame &source_frame, Frame *frame)
+{
+    unsigned long sequence = ring_.publishedCount() + 1;
+
+    // formats the GPU can not take as they are are converted while copying
+    bool direct = PixelFormat::isDirect(source_frame.format);
+    int width = source_frame.width / downscale_;
+    int height = source_frame.height / downscale_;
+    int stride = downscale_ > 1 || !direct ? width * 4 : source_frame.stride;
+    PixelFormat::Format format = PixelFormat::directFormat(source_frame.format);
+
+    bool resized = frame->width != width || frame->height != height || frame->stride != stride ||
+                   frame->format != format;
+    frame->width = width;
+    frame->height = height;
+    frame->stride = stride;
+    frame->format = format;
+    frame->pixels.resize((size_t) frame->stride * frame->height);
+
+    // the slot still holds the frame it was last published with, find everything that changed since then
+    bool covered = frame->sequence > 0 &&
+                   (history_.empty() ? frame->sequence + 1 == sequence
+                                     : history_.front().sequence <= frame->sequence + 1);
+    std::vector<Rect> rects(source_frame.dirty);
+    for (const DirtyHistory &entry : history_) {
+        if (entry.sequence <= frame->sequence)
+            continue;
+        if (entry.full)
+            covered = false;
+        rects.insert(rects.end(), entry.rects.begin(), entry.rects.end());
+    }
+
+    if (source_frame.full || resized || !covered) {
+        Rect frame_rect = {0, 0, source_frame.width, source_frame.height};
+        copyRegion(source_frame, frame, frame_rect);
+        return;
+    }
+
+    for (const Rect &rect : rects)
+        copyRegion(source_frame, frame, rect);
+}
+
+void CaptureThread::copyRegion(const SourceFrame &source_frame, Frame *frame, const Rect &rect)
+{
+    if (!PixelFormat::isDirect(source_frame.format)) {
+        convertRegion(source_frame, frame, rect);
+        return;
+    }
+
+    if (downscale_ > 1) {
+        Rect target = Downscale::scaleRect(rect, downscale_, frame->width, frame->height);
+        Downscale::box(source_frame.pixels, source_frame.stride, downscale_, frame->pixels.data(), frame->stride,
+                       target);
+        return;
+    }
+
+    if (rect.x == 0 && rect.width == source_frame.width) {
+        std::memcpy(frame->pixels.data() + (size_t) frame->stride * rect.y,
+                    source_frame.pixels + (size_t) frame->stride * rect.y, (size_t) frame->stride * rect.height);
+        return;
+    }
+
+    size_t offset = (size_t) frame->stride * rect.y + (size_t) rect.x * 4;
+    for (int y = 0; y < rect.height; ++y) {
+        std::memcpy(frame->pixels.data() + offset, source_frame.pixels + offset, (size_t) rect.width * 4);
+        offset += frame->stride;
+    }
+}
+
+void CaptureThread::convertRegion(const SourceFrame &source_frame, Frame *frame, const Rect &rect)
+{
+    int bytes_per_pixel = PixelFormat::bytesPerPixel(source_frame.format);
+
+    if (downscale_ == 1) {
+        const unsigned char *source = source_frame.pixels + (size_t) source_frame.stride * rect.y +
+                                      (size_t) rect.x * bytes_per_pixel;
+        unsigned char *target = frame->pixels.data() + (size_t) frame->stride * rect.y + (size_t) rect.x * 4;
+        PixelFormat::convert(source, source_frame.stride, source_frame.format, target, frame->stride, frame->format,
+                             rect.width, rect.height);
+        return;
+    }
+
+    // convert the source rows the downscaled region reads into a 32 bit copy and filter that one
+    Rect target = Downscale::scaleRect(rect, downscale_, frame->width, frame->height);
+    int first_row = target.y * downscale_;
+    int rows = target.height * downscale_;
+    int stride = source_frame.width * 4;
+    convert_buffer_.resize((size_t) stride * source_frame.height);
+
+    int left = target.x * downscale_;
+    PixelFormat::convert(source_frame.pixels + (size_t) source_frame.stride * first_row +
+                         (size_t) left * bytes_per_pixel, source_frame.stride, source_frame.format,
+                         convert_buffer_.data() + (size_t) stride * first_row + (size_t) left * 4, stride,
+                         frame->format, target.width * downscale_, rows);
+    Downscale::box(convert_buffer_.data(), stride, downscale_, frame->pixels.data(), frame->stride, target);
+}
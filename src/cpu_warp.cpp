@@ -0,0 +1,361 @@
+#include "../inc/cpu_warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_WARP_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// rows of the output rasterised together, every band has its own depth buffer
+const int BAKE_BAND_HEIGHT = 32;
+
+const uint32_t BLACK = 0xff000000u;
+
+float edge(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p)
+{
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// pixel centers exactly on an edge shared by two triangles belong to only one of them
+bool ownsEdge(const glm::vec2 &a, const glm::vec2 &b)
+{
+    return b.y > a.y || (b.y == a.y && b.x < a.x);
+}
+
+void warpRowScalar(const float *map_u, const float *map_t, int count, const unsigned char *src, int src_width,
+                   int src_height, int src_stride, uint32_t *dst)
+{
+    auto width = (float) src_width;
+    auto height = (float) src_height;
+
+    for (int i = 0; i < count; ++i) {
+        if (!(map_u[i] >= 0.0f)) {
+            dst[i] = BLACK;
+            continue;
+        }
+
+        // texel centers are at half coordinates
+        float sx = map_u[i] * width - 0.5f;
+        float sy = map_t[i] * height - 0.5f;
+        float fx = std::floor(sx);
+        float fy = std::floor(sy);
+        float ax = sx - fx;
+        float ay = sy - fy;
+
+        // repeat wrapping like the default GL sampler state
+        fx = fx - width * std::floor(fx / width);
+        fy = fy - height * std::floor(fy / height);
+        auto x0 = (int) fx;
+        auto y0 = (int) fy;
+        int x1 = x0 + 1 == src_width ? 0 : x0 + 1;
+        int y1 = y0 + 1 == src_height ? 0 : y0 + 1;
+
+        float w00 = (1.0f - ax) * (1.0f - ay);
+        float w10 = ax * (1.0f - ay);
+        float w01 = (1.0f - ax) * ay;
+        float w11 = ax * ay;
+
+        const unsigned char *p00 = src + (size_t) y0 * src_stride + x0 * 4;
+        const unsigned char *p10 = src + (size_t) y0 * src_stride + x1 * 4;
+        const unsigned char *p01 = src + (size_t) y1 * src_stride + x0 * 4;
+        const unsigned char *p11 = src + (size_t) y1 * src_stride + x1 * 4;
+
+        uint32_t pixel = BLACK;
+        for (int c = 0; c < 3; ++c) {
+            float value = p00[c] * w00 + p10[c] * w10 + p01[c] * w01 + p11[c] * w11;
+            pixel |= (uint32_t) (int) (value + 0.5f) << (8 * c);
+        }
+        dst[i] = pixel;
+    }
+}
+
+#ifdef CPU_WARP_X86
+
+// same arithmetic in the same order as warpRowScalar, so both produce identical pixels
+__attribute__((target("avx2")))
+void warpRowAVX2(const float *map_u, const float *map_t, int count, const unsigned char *src, int src_width,
+                 int src_height, int src_stride, uint32_t *dst)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 width = _mm256_set1_ps((float) src_width);
+    const __m256 height = _mm256_set1_ps((float) src_height);
+    const __m256i width_i = _mm256_set1_epi32(src_width);
+    const __m256i height_i = _mm256_set1_epi32(src_height);
+    const __m256i one_i = _mm256_set1_epi32(1);
+    const __m256i stride = _mm256_set1_epi32(src_stride / 4);
+    const __m256i channel_mask = _mm256_set1_epi32(0xff);
+    const __m256i black = _mm256_set1_epi32((int) BLACK);
+    const auto *pixels = (const int *) src;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 u = _mm256_loadu_ps(map_u + i);
+        __m256 t = _mm256_loadu_ps(map_t + i);
+        __m256i valid = _mm256_castps_si256(_mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+        if (_mm256_testz_si256(valid, valid)) {
+            _mm256_storeu_si256((__m256i *) (dst + i), black);
+            continue;
+        }
+
+        __m256 sx = _mm256_sub_ps(_mm256_mul_ps(u, width), half);
+        __m256 sy = _mm256_sub_ps(_mm256_mul_ps(t, height), half);
+        __m256 fx = _mm256_floor_ps(sx);
+        __m256 fy = _mm256_floor_ps(sy);
+        __m256 ax = _mm256_sub_ps(sx, fx);
+        __m256 ay = _mm256_sub_ps(sy, fy);
+
+        fx = _mm256_sub_ps(fx, _mm256_mul_ps(width, _mm256_floor_ps(_mm256_div_ps(fx, width))));
+        fy = _mm256_sub_ps(fy, _mm256_mul_ps(height, _mm256_floor_ps(_mm256_div_ps(fy, height))));
+        __m256i x0 = _mm256_cvttps_epi32(fx);
+        __m256i y0 = _mm256_cvttps_epi32(fy);
+        __m256i x1 = _mm256_add_epi32(x0, one_i);
+        __m256i y1 = _mm256_add_epi32(y0, one_i);
+        x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(x1, width_i), x1);
+        y1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(y1, height_i), y1);
+
+        // pixels outside the mesh fetch the first texel instead of whatever their coordinate points to
+        __m256i row0 = _mm256_and_si256(_mm256_mullo_epi32(y0, stride), valid);
+        __m256i row1 = _mm256_and_si256(_mm256_mullo_epi32(y1, stride), valid);
+        x0 = _mm256_and_si256(x0, valid);
+        x1 = _mm256_and_si256(x1, valid);
+        __m256i p00 = _mm256_i32gather_epi32(pixels, _mm256_add_epi32(row0, x0), 4);
+        __m256i p10 = _mm256_i32gather_epi32(pixels, _mm256_add_epi32(row0, x1), 4);
+        __m256i p01 = _mm256_i32gather_epi32(pixels, _mm256_add_epi32(row1, x0), 4);
+        __m256i p11 = _mm256_i32gather_epi32(pixels, _mm256_add_epi32(row1, x1), 4);
+
+        __m256 bx = _mm256_sub_ps(one, ax);
+        __m256 by = _mm256_sub_ps(one, ay);
+        __m256 w00 = _mm256_mul_ps(bx, by);
+        __m256 w10 = _mm256_mul_ps(ax, by);
+        __m256 w01 = _mm256_mul_ps(bx, ay);
+        __m256 w11 = _mm256_mul_ps(ax, ay);
+
+        __m256i result = black;
+        for (int c = 0; c < 3; ++c) {
+            __m256 c00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p00, 8 * c), channel_mask));
+            __m256 c10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p10, 8 * c), channel_mask));
+            __m256 c01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p01, 8 * c), channel_mask));
+            __m256 c11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p11, 8 * c), channel_mask));
+            __m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c00, w00),
+                                                                     _mm256_mul_ps(c10, w10)),
+                                                       _mm256_mul_ps(c01, w01)), _mm256_mul_ps(c11, w11));
+            __m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(value, half));
+            result = _mm256_or_si256(result, _mm256_slli_epi32(channel, 8 * c));
+        }
+
+        result = _mm256_blendv_epi8(black, result, valid);
+        _mm256_storeu_si256((__m256i *) (dst + i), result);
+    }
+    warpRowScalar(map_u + i, map_t + i, count - i, src, src_width, src_height, src_stride, dst + i);
+}
+
+bool hasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif
+
+}
+
+const int CpuWarp::TILE_WIDTH;
+const int CpuWarp::TILE_HEIGHT;
+
+CpuWarp::CpuWarp(int threads)
+        : pool_(threads),
+          width_(0),
+          height_(0),
+          map_u_(),
+          map_t_()
+{
+}
+
+bool CpuWarp::bake(const WarpMeshData &mesh, const glm::mat4 &mvp, int width, int height)
+{
+    if (width <= 0 || height <= 0 || mesh.indices.size() % 3 != 0)
+        return false;
+
+    width_ = width;
+    height_ = height;
+    map_u_.assign((size_t) width * height, -1.0f);
+    map_t_.assign((size_t) width * height, 0.0f);
+
+    // clip space to window coordinates with the GL viewport and depth range, y grows upwards
+    std::vector<WindowVertex> window(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const WarpVertex &vertex = mesh.vertices[i];
+        glm::vec4 clip = mvp * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f);
+        if (clip.w <= 0.0f) {
+            // behind the camera, triangles using it are dropped instead of clipped
+            window[i] = {0.0f, 0.0f, 0.0f, 0.0f};
+            continue;
+        }
+        float inverse_w = 1.0f / clip.w;
+        window[i] = {(clip.x * inverse_w * 0.5f + 0.5f) * (float) width,
+                     (clip.y * inverse_w * 0.5f + 0.5f) * (float) height,
+                     clip.z * inverse_w * 0.5f + 0.5f, inverse_w};
+    }
+
+    int bands = (height + BAKE_BAND_HEIGHT - 1) / BAKE_BAND_HEIGHT;
+    pool_.run(bands, [&](int band) {
+        bakeBand(window, mesh, band * BAKE_BAND_HEIGHT, std::min((band + 1) * BAKE_BAND_HEIGHT, height));
+    });
+    return true;
+}
+
+void CpuWarp::warp(const unsigned char *src, int src_width, int src_height, int src_stride, unsigned char *dst,
+                   int dst_stride)
+{
+#ifdef CPU_WARP_X86
+    warpTiles(src, src_width, src_height, src_stride, dst, dst_stride, hasAVX2());
+#else
+    warpTiles(src, src_width, src_height, src_stride, dst, dst_stride, false);
+#endif
+}
+
+void CpuWarp::warpScalar(const unsigned char *src, int src_width, int src_height, int src_stride,
+                         unsigned char *dst, int dst_stride)
+{
+    warpTiles(src, src_width, src_height, src_stride, dst, dst_stride, false);
+}
+
+int CpuWarp::width() const
+{
+    return width_;
+}
+
+int CpuWarp::height() const
+{
+    return height_;
+}
+
+int CpuWarp::threadCount() const
+{
+    return pool_.threadCount();
+}
+
+double CpuWarp::coverage() const
+{
+    if (map_u_.empty())
+        return 0.0;
+    auto covered = std::count_if(map_u_.begin(), map_u_.end(), [](float u) { return u >= 0.0f; });
+    return (double) covered / (double) map_u_.size();
+}
+
+const char *CpuWarp::kernelName()
+{
+#ifdef CPU_WARP_X86
+    return hasAVX2() ? "AVX2" : "scalar";
+#else
+    return "scalar";
+#endif
+}
+
+void CpuWarp::bakeBand(const std::vector<WindowVertex> &window, const WarpMeshData &mesh, int y_begin, int y_end)
+{
+    std::vector<float> depth((size_t) width_ * (y_end - y_begin), 1.0f);
+
+    // in draw order, so equal depths resolve like GL_LESS does
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t index[3] = {mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]};
+        const WindowVertex *v[3] = {&window[index[0]], &window[index[1]], &window[index[2]]};
+        if (v[0]->inverse_w == 0.0f || v[1]->inverse_w == 0.0f || v[2]->inverse_w == 0.0f)
+            continue;
+
+        float min_y = std::min(std::min(v[0]->y, v[1]->y), v[2]->y);
+        float max_y = std::max(std::max(v[0]->y, v[1]->y), v[2]->y);
+        int row_begin = std::max((int) std::ceil(min_y - 0.5f), y_begin);
+        int row_end = std::min((int) std::floor(max_y - 0.5f) + 1, y_end);
+        if (row_begin >= row_end)
+            continue;
+
+        glm::vec2 p[3] = {glm::vec2(v[0]->x, v[0]->y), glm::vec2(v[1]->x, v[1]->y), glm::vec2(v[2]->x, v[2]->y)};
+        float area = edge(p[0], p[1], p[2]);
+        if (area == 0.0f)
+            continue;
+
+        // counter clockwise order, so inside is positive for every edge
+        if (area < 0.0f) {
+            std::swap(p[1], p[2]);
+            std::swap(v[1], v[2]);
+            std::swap(index[1], index[2]);
+            area = -area;
+        }
+
+        float min_x = std::min(std::min(p[0].x, p[1].x), p[2].x);
+        float max_x = std::max(std::max(p[0].x, p[1].x), p[2].x);
+        int column_begin = std::max((int) std::ceil(min_x - 0.5f), 0);
+        int column_end = std::min((int) std::floor(max_x - 0.5f) + 1, width_);
+        bool owns[3] = {ownsEdge(p[1], p[2]), ownsEdge(p[2], p[0]), ownsEdge(p[0], p[1])};
+
+        // attributes divided by w are linear in screen space
+        const WarpVertex *vertex[3] = {&mesh.vertices[index[0]], &mesh.vertices[index[1]], &mesh.vertices[index[2]]};
+        float u_w[3], v_w[3];
+        for (int k = 0; k < 3; ++k) {
+            u_w[k] = vertex[k]->u * v[k]->inverse_w;
+            v_w[k] = vertex[k]->v * v[k]->inverse_w;
+        }
+
+        for (int y = row_begin; y < row_end; ++y) {
+            float *depth_row = depth.data() + (size_t) (y - y_begin) * width_;
+            size_t map_row = (size_t) (height_ - 1 - y) * width_;
+            for (int x = column_begin; x < column_end; ++x) {
+                glm::vec2 center((float) x + 0.5f, (float) y + 0.5f);
+                float e[3] = {edge(p[1], p[2], center), edge(p[2], p[0], center), edge(p[0], p[1], center)};
+                if (e[0] < 0.0f || e[1] < 0.0f || e[2] < 0.0f || (e[0] == 0.0f && !owns[0]) ||
+                    (e[1] == 0.0f && !owns[1]) || (e[2] == 0.0f && !owns[2]))
+                    continue;
+
+                float b0 = e[0] / area;
+                float b1 = e[1] / area;
+                float b2 = e[2] / area;
+                float z = b0 * v[0]->z + b1 * v[1]->z + b2 * v[2]->z;
+                if (z < 0.0f || z > 1.0f || z >= depth_row[x])
+                    continue;
+                depth_row[x] = z;
+
+                float inverse_w = b0 * v[0]->inverse_w + b1 * v[1]->inverse_w + b2 * v[2]->inverse_w;
+                map_u_[map_row + x] = (b0 * u_w[0] + b1 * u_w[1] + b2 * u_w[2]) / inverse_w;
+                map_t_[map_row + x] = 1.0f - (b0 * v_w[0] + b1 * v_w[1] + b2 * v_w[2]) / inverse_w;
+            }
+        }
+    }
+}
+
+void CpuWarp::warpTiles(const unsigned char *src, int src_width, int src_height, int src_stride,
+                        unsigned char *dst, int dst_stride, bool simd)
+{
+    if (map_u_.empty())
+        return;
+
+    auto row_kernel = warpRowScalar;
+#ifdef CPU_WARP_X86
+    if (simd)
+        row_kernel = warpRowAVX2;
+#else
+    (void) simd;
+#endif
+
+    int tiles_x = (width_ + TILE_WIDTH - 1) / TILE_WIDTH;
+    int tiles_y = (height_ + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    pool_.run(tiles_x * tiles_y, [&](int tile) {
+        int x_begin = (tile % tiles_x) * TILE_WIDTH;
+        int y_begin = (tile / tiles_x) * TILE_HEIGHT;
+        int count = std::min(TILE_WIDTH, width_ - x_begin);
+        int y_end = std::min(y_begin + TILE_HEIGHT, height_);
+        for (int y = y_begin; y < y_end; ++y) {
+            size_t offset = (size_t) y * width_ + x_begin;
+            row_kernel(map_u_.data() + offset, map_t_.data() + offset, count, src, src_width, src_height,
+                       src_stride, (uint32_t *) (dst + (size_t) y * dst_stride) + x_begin);
+        }
+    });
+}
@@ -0,0 +1,138 @@
+#include "../inc/damage_tracker.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sys/select.h>
+
+DamageTracker::DamageTracker(Display *display, Window window)
+        : display_(display),
+          window_(window),
+          damage_(0),
+          parts_(0),
+          event_base_(0),
+          pending_(false),
+          x_(0),
+          y_(0),
+          width_(0),
+          height_(0),
+          threshold_(1.0f)
+{
+}
+
+DamageTracker::~DamageTracker()
+{
+    close();
+}
+
+bool DamageTracker::open(int x, int y, int width, int height, float full_frame_threshold)
+{
+    close();
+
+    int error_base;
+    if (!XDamageQueryExtension(display_, &event_base_, &error_base)) {
+        std::cout << "Capture: XDamage unavailable, capturing every frame" << std::endl;
+        return false;
+    }
+
+    x_ = x;
+    y_ = y;
+    width_ = width;
+    height_ = height;
+    threshold_ = full_frame_threshold;
+
+    // report once whenever the damage turns non-empty, the region itself is fetched on collect
+    damage_ = XDamageCreate(display_, window_, XDamageReportNonEmpty);
+    parts_ = XFixesCreateRegion(display_, nullptr, 0);
+
+    // the first collect always reports the whole region
+    pending_ = true;
+
+    std::cout << "Capture: tracking damage, full frame above " << (threshold_ * 100.0f) << "% change" << std::endl;
+    return true;
+}
+
+void DamageTracker::close()
+{
+    if (damage_) {
+        XDamageDestroy(display_, damage_);
+        XFixesDestroyRegion(display_, parts_);
+        XSync(display_, False);
+    }
+    damage_ = 0;
+    parts_ = 0;
+}
+
+bool DamageTracker::isOpen() const
+{
+    return damage_ != 0;
+}
+
+bool DamageTracker::collect(std::vector<Rect> *rects, bool *full)
+{
+    bool first = pending_;
+    pending_ = false;
+
+    bool damaged = first;
+    while (XPending(display_)) {
+        XEvent event;
+        XNextEvent(display_, &event);
+        if (event.type == event_base_ + XDamageNotify)
+            damaged = true;
+    }
+
+    rects->clear();
+    *full = first;
+    if (!damaged)
+        return false;
+
+    // move the accumulated damage into our region, which also rearms the notify
+    XDamageSubtract(display_, damage_, None, parts_);
+    if (first)
+        return true;
+
+    int count = 0;
+    XRectangle *parts = XFixesFetchRegion(display_, parts_, &count);
+
+    long area = 0;
+    for (int i = 0; i < count; ++i) {
+        // clip to the tracked region and move into frame coordinates
+        int left = std::max((int) parts[i].x, x_);
+        int top = std::max((int) parts[i].y, y_);
+        int right = std::min((int) parts[i].x + (int) parts[i].width, x_ + width_);
+        int bottom = std::min((int) parts[i].y + (int) parts[i].height, y_ + height_);
+        if (right <= left || bottom <= top)
+            continue;
+
+        Rect rect = {left - x_, top - y_, right - left, bottom - top};
+        rects->push_back(rect);
+        area += (long) rect.width * rect.height;
+    }
+    if (parts)
+        XFree(parts);
+
+    // damage outside of the captured region does not count as change
+    if (rects->empty())
+        return false;
+
+    if ((int) rects->size() > MAX_RECTS || area > threshold_ * (float) width_ * (float) height_) {
+        rects->clear();
+        *full = true;
+    }
+    return true;
+}
+
+void DamageTracker::waitForDamage(double timeout_seconds)
+{
+    if (XPending(display_))
+        return;
+
+    int fd = ConnectionNumber(display_);
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+
+    timeval timeout;
+    timeout.tv_sec = (long) timeout_seconds;
+    timeout.tv_usec = (long) ((timeout_seconds - (double) timeout.tv_sec) * 1000000.0);
+    select(fd + 1, &fds, nullptr, nullptr, &timeout);
+}
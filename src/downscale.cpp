@@ -0,0 +1,201 @@
+#include "../inc/downscale.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DOWNSCALE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// above this factor the 16 bit block sums of the vector kernels could overflow
+const int MAX_SIMD_FACTOR = 16;
+
+#ifdef DOWNSCALE_X86
+
+// sums factor consecutive pixels of the vertical sums and writes the rounded means
+void reduceRowSSE2(const uint16_t *sums, int factor, int width, unsigned char *dst)
+{
+    int count = factor * factor;
+    bool power_of_two = (count & (count - 1)) == 0;
+    int shift = 0;
+    while ((1 << shift) < count)
+        ++shift;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16((short) (count / 2));
+    const __m128 scale = _mm_set1_ps(1.0f / (float) count);
+    const __m128 rounding = _mm_set1_ps(0.5f);
+
+    int x = 0;
+    if (factor == 2) {
+        // the common 2x2 case reduces two destination pixels per step
+        for (; x + 2 <= width; x += 2) {
+            __m128i left = _mm_loadu_si128((const __m128i *) sums);
+            __m128i right = _mm_loadu_si128((const __m128i *) (sums + 8));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+            __m128i mean = _mm_srli_epi16(_mm_add_epi16(sum, half), 2);
+            _mm_storel_epi64((__m128i *) dst, _mm_packus_epi16(mean, zero));
+            sums += 16;
+            dst += 8;
+        }
+    }
+
+    for (; x < width; ++x) {
+        // four 16 bit channel sums per pixel
+        __m128i sum = _mm_loadl_epi64((const __m128i *) sums);
+        for (int i = 1; i < factor; ++i)
+            sum = _mm_add_epi16(sum, _mm_loadl_epi64((const __m128i *) (sums + i * 4)));
+        sums += factor * 4;
+
+        __m128i mean;
+        if (power_of_two) {
+            mean = _mm_srli_epi16(_mm_add_epi16(sum, half), shift);
+        } else {
+            __m128 value = _mm_cvtepi32_ps(_mm_unpacklo_epi16(sum, zero));
+            mean = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), rounding));
+            mean = _mm_packs_epi32(mean, zero);
+        }
+
+        int packed = _mm_cvtsi128_si32(_mm_packus_epi16(mean, zero));
+        std::copy((const unsigned char *) &packed, (const unsigned char *) &packed + 4, dst);
+        dst += 4;
+    }
+}
+
+void boxSSE2(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+             const Rect &dst_rect)
+{
+    static thread_local std::vector<uint16_t> sums;
+    int span = dst_rect.width * factor * 4;
+    sums.resize((size_t) span + 16);
+
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = dst_rect.y; y < dst_rect.y + dst_rect.height; ++y) {
+        const unsigned char *row = src + (size_t) src_stride * y * factor + (size_t) dst_rect.x * factor * 4;
+        std::fill(sums.begin(), sums.end(), 0);
+
+        // vertical pass: widen to 16 bit and accumulate factor rows, 16 bytes at a time
+        for (int r = 0; r < factor; ++r) {
+            const unsigned char *line = row + (size_t) src_stride * r;
+            int i = 0;
+            for (; i + 16 <= span; i += 16) {
+                __m128i pixels = _mm_loadu_si128((const __m128i *) (line + i));
+                __m128i *target = (__m128i *) (sums.data() + i);
+                _mm_storeu_si128(target, _mm_add_epi16(_mm_loadu_si128(target), _mm_unpacklo_epi8(pixels, zero)));
+                _mm_storeu_si128(target + 1,
+                                 _mm_add_epi16(_mm_loadu_si128(target + 1), _mm_unpackhi_epi8(pixels, zero)));
+            }
+            for (; i < span; ++i)
+                sums[i] = (uint16_t) (sums[i] + line[i]);
+        }
+
+        reduceRowSSE2(sums.data(), factor, dst_rect.width,
+                      dst + (size_t) dst_stride * y + (size_t) dst_rect.x * 4);
+    }
+}
+
+__attribute__((target("avx2")))
+void boxAVX2(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+             const Rect &dst_rect)
+{
+    static thread_local std::vector<uint16_t> sums;
+    int span = dst_rect.width * factor * 4;
+    sums.resize((size_t) span + 16);
+
+    for (int y = dst_rect.y; y < dst_rect.y + dst_rect.height; ++y) {
+        const unsigned char *row = src + (size_t) src_stride * y * factor + (size_t) dst_rect.x * factor * 4;
+        std::fill(sums.begin(), sums.end(), 0);
+
+        // vertical pass: widen to 16 bit and accumulate factor rows, 32 bytes at a time
+        for (int r = 0; r < factor; ++r) {
+            const unsigned char *line = row + (size_t) src_stride * r;
+            int i = 0;
+            for (; i + 32 <= span; i += 32) {
+                __m128i low = _mm_loadu_si128((const __m128i *) (line + i));
+                __m128i high = _mm_loadu_si128((const __m128i *) (line + i + 16));
+                __m256i *target = (__m256i *) (sums.data() + i);
+                _mm256_storeu_si256(target, _mm256_add_epi16(_mm256_loadu_si256(target), _mm256_cvtepu8_epi16(low)));
+                _mm256_storeu_si256(target + 1,
+                                    _mm256_add_epi16(_mm256_loadu_si256(target + 1), _mm256_cvtepu8_epi16(high)));
+            }
+            for (; i < span; ++i)
+                sums[i] = (uint16_t) (sums[i] + line[i]);
+        }
+
+        reduceRowSSE2(sums.data(), factor, dst_rect.width,
+                      dst + (size_t) dst_stride * y + (size_t) dst_rect.x * 4);
+    }
+}
+
+bool hasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif
+
+}
+
+void Downscale::box(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+                    const Rect &dst_rect)
+{
+    if (dst_rect.width <= 0 || dst_rect.height <= 0)
+        return;
+
+#ifdef DOWNSCALE_X86
+    if (factor > 1 && factor <= MAX_SIMD_FACTOR) {
+        if (hasAVX2())
+            boxAVX2(src, src_stride, factor, dst, dst_stride, dst_rect);
+        else
+            boxSSE2(src, src_stride, factor, dst, dst_stride, dst_rect);
+        return;
+    }
+#endif
+
+    boxScalar(src, src_stride, factor, dst, dst_stride, dst_rect);
+}
+
+Rect Downscale::scaleRect(const Rect &src_rect, int factor, int dst_width, int dst_height)
+{
+    int left = src_rect.x / factor;
+    int top = src_rect.y / factor;
+    int right = std::min((src_rect.x + src_rect.width + factor - 1) / factor, dst_width);
+    int bottom = std::min((src_rect.y + src_rect.height + factor - 1) / factor, dst_height);
+
+    Rect rect = {left, top, std::max(right - left, 0), std::max(bottom - top, 0)};
+    return rect;
+}
+
+const char *Downscale::kernelName()
+{
+#ifdef DOWNSCALE_X86
+    return hasAVX2() ? "AVX2" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void Downscale::boxScalar(const unsigned char *src, int src_stride, int factor, unsigned char *dst, int dst_stride,
+                          const Rect &dst_rect)
+{
+    unsigned int count = (unsigned int) (factor * factor);
+    for (int y = dst_rect.y; y < dst_rect.y + dst_rect.height; ++y) {
+        unsigned char *target = dst + (size_t) dst_stride * y + (size_t) dst_rect.x * 4;
+        for (int x = dst_rect.x; x < dst_rect.x + dst_rect.width; ++x) {
+            unsigned int sum[4] = {0, 0, 0, 0};
+            for (int r = 0; r < factor; ++r) {
+                const unsigned char *block = src + (size_t) src_stride * (y * factor + r) + (size_t) x * factor * 4;
+                for (int i = 0; i < factor * 4; ++i)
+                    sum[i & 3] += block[i];
+            }
+            for (int c = 0; c < 4; ++c)
+                target[c] = (unsigned char) ((sum[c] + count / 2) / count);
+            target += 4;
+        }
+    }
+}
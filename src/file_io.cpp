@@ -1,32 +1,243 @@
 #include "../inc/file_io.h"
 
-#include <fstream>
-#include <sstream>
-#include <string>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
 
-bool FileIO::loadFile(const char *filepath, std::vector<glm::vec3> *to_fill)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// the correctly rounded float of mantissa * 10^exponent if it can be had from one double operation, false otherwise
+bool fastPath(uint64_t mantissa, int exponent, float *value)
+{
+    // both operands are exact doubles, so the double result is correctly rounded
+    if (mantissa > (1ull << 53) || exponent > 22 || exponent < -22)
+        return false;
+    double result = exponent >= 0 ? (double) mantissa * POWERS_OF_TEN[exponent]
+                                  : (double) mantissa / POWERS_OF_TEN[-exponent];
+
+    // rounding that double to float again can only go wrong if it lies exactly halfway between two floats, which
+    // is the 29 bits below the float mantissa being 1000..., or if the float is subnormal
+    if (result != 0.0 && result < (double) FLT_MIN)
+        return false;
+    uint64_t bits;
+    std::memcpy(&bits, &result, sizeof(bits));
+    if ((bits & ((1ull << 29) - 1)) == (1ull << 28))
+        return false;
+
+    *value = (float) result;
+    return true;
+}
+
+// the number with its decimal point removed, which strtof reads the same in every locale
+float parseWithoutPoint(const char *begin, const char *end, int written_exponent)
 {
-    std::ifstream f;
-    std::string s;
+    std::string number;
+    int fraction_digits = 0;
+    bool fraction = false;
+    for (const char *cursor = begin; cursor < end; ++cursor) {
+        if (*cursor == '.') {
+            fraction = true;
+        } else {
+            number += *cursor;
+            fraction_digits += fraction;
+        }
+    }
+    number += 'e' + std::to_string(written_exponent - fraction_digits);
+    return std::strtof(number.c_str(), nullptr);
+}
+
+// parses the lines in [begin, end), like the stream based loader a line needs three leading numbers
+void parseLines(const char *begin, const char *end, std::vector<glm::vec3> *points)
+{
+    const char *position = begin;
+    while (position < end) {
+        const char *line_end = (const char *) std::memchr(position, '\n', (size_t) (end - position));
+        if (!line_end)
+            line_end = end;
+
+        float values[3];
+        int count = 0;
+        const char *cursor = position;
+        for (; count < 3; ++count) {
+            while (cursor < line_end && isSpace(*cursor))
+                ++cursor;
+            const char *next = FileIO::parseFloat(cursor, line_end, &values[count]);
+            if (next == cursor)
+                break;
+            cursor = next;
+        }
 
-    f.open(filepath, std::ios::in);
+        // skip empty lines, e.g. the one after the final newline
+        if (count == 3)
+            points->push_back(glm::vec3(values[0], values[1], values[2]));
 
-    if (f.is_open()) {
-        std::cout << "Loading file: '" << filepath << "'!" << std::endl;
-        while (!f.eof()) {
-            getline(f, s);
-            std::istringstream iss(s);
+        position = line_end + 1;
+    }
+}
+
+}
 
-            float x, y, z;
-            iss >> x >> y >> z;
+const char *FileIO::parseFloat(const char *begin, const char *end, float *value)
+{
+    const char *cursor = begin;
+    bool negative = false;
+    if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+        negative = *cursor == '-';
+        ++cursor;
+    }
 
-            // append to input vector
-            to_fill->push_back(glm::vec3(x, y, z));
+    // up to 19 significant digits fit the mantissa, the rest only shifts the exponent
+    const char *digits_begin = cursor;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor) {
+        any_digit = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+            digits += mantissa != 0;
+        } else {
+            ++exponent;
+        }
+    }
+    if (cursor < end && *cursor == '.') {
+        for (++cursor; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor) {
+            any_digit = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
         }
+    }
+    if (!any_digit)
+        return begin;
+    const char *digits_end = cursor;
+
+    int written_exponent = 0;
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        const char *exponent_start = cursor + 1;
+        bool exponent_negative = false;
+        if (exponent_start < end && (*exponent_start == '-' || *exponent_start == '+')) {
+            exponent_negative = *exponent_start == '-';
+            ++exponent_start;
+        }
+        if (exponent_start < end && *exponent_start >= '0' && *exponent_start <= '9') {
+            for (cursor = exponent_start; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+                written_exponent = std::min(written_exponent * 10 + (*cursor - '0'), 100000);
+            if (exponent_negative)
+                written_exponent = -written_exponent;
+        }
+    }
+
+    // the few numbers the fast path can not round correctly, e.g. with more than 16 digits, go through strtof
+    float result = 0.0f;
+    if (mantissa != 0 && !fastPath(mantissa, exponent + written_exponent, &result))
+        result = parseWithoutPoint(digits_begin, digits_end, written_exponent);
+    *value = negative ? -result : result;
+    return cursor;
+}
+
+bool FileIO::loadFile(const char *filepath, std::vector<glm::vec3> *to_fill)
+{
+    int fd = open(filepath, O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0) {
+        if (fd >= 0)
+            close(fd);
+        std::cout << "Error loading file: '" << filepath << "'!" << std::endl;
+        return false;
+    }
+
+    std::cout << "Loading file: '" << filepath << "'!" << std::endl;
+    auto size = (size_t) file_stat.st_size;
+    if (size == 0) {
+        close(fd);
         return true;
     }
 
-    std::cout << "Error loading file: '" << filepath << "'!" << std::endl;
-    return false;
-}
\ No newline at end of file
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cout << "Error loading file: '" << filepath << "'!" << std::endl;
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    const char *data = (const char *) mapping;
+
+    // split at line starts into one chunk per thread, small files are parsed in one go
+    size_t chunk_count = std::min((size_t) std::max(std::thread::hardware_concurrency(), 1u),
+                                  std::max(size / PARALLEL_CHUNK_SIZE, (size_t) 1));
+    std::vector<const char *> bounds(1, data);
+    for (size_t i = 1; i < chunk_count; ++i) {
+        const char *split = std::max(data + size * i / chunk_count, bounds.back());
+        const char *newline = (const char *) std::memchr(split, '\n', (size_t) (data + size - split));
+        bounds.push_back(newline ? newline + 1 : data + size);
+    }
+    bounds.push_back(data + size);
+
+    std::vector<std::vector<glm::vec3>> chunks(chunk_count);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        workers.emplace_back([&, i]() {
+            chunks[i].reserve((size_t) (bounds[i + 1] - bounds[i]) / 24);
+            parseLines(bounds[i], bounds[i + 1], &chunks[i]);
+        });
+    }
+    chunks[0].reserve((size_t) (bounds[1] - bounds[0]) / 24);
+    parseLines(bounds[0], bounds[1], &chunks[0]);
+    for (std::thread &worker : workers)
+        worker.join();
+    munmap(mapping, size);
+
+    size_t total = to_fill->size();
+    for (const std::vector<glm::vec3> &chunk : chunks)
+        total += chunk.size();
+    to_fill->reserve(total);
+    for (const std::vector<glm::vec3> &chunk : chunks)
+        to_fill->insert(to_fill->end(), chunk.begin(), chunk.end());
+    return true;
+}
+
+bool FileIO::loadMesh(const char *filepath, std::vector<glm::vec3> *points, MeshLayout *layout)
+{
+    points->clear();
+    if (!loadFile(filepath, points))
+        return false;
+    if (points->empty()) {
+        std::cout << "Error loading file: '" << filepath << "' is empty!" << std::endl;
+        return false;
+    }
+
+    // the last line holds the layout
+    layout->rings = (int) points->back().x;
+    layout->points_per_ring = (int) points->back().y;
+    layout->point_count = (int) points->back().z;
+    points->pop_back();
+
+    if ((int) points->size() != layout->point_count) {
+        std::cout << "Error loading file: '" << filepath << "' has " << points->size() << " points, "
+                  << layout->point_count << " declared!" << std::endl;
+        return false;
+    }
+    return true;
+}
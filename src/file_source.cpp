@@ -0,0 +1,165 @@
+#include "../inc/file_source.h"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char FileSource::MAGIC[4] = {'G', 'L', 'W', 'F'};
+
+FileSource::FileSource(const FrameSourceSettings &settings)
+        : settings_(settings),
+          mapping_(nullptr),
+          mapping_size_(0),
+          record_size_(0),
+          header_(),
+          next_frame_(0),
+          first_timestamp_(0),
+          start_time_()
+{
+}
+
+FileSource::~FileSource()
+{
+    close();
+}
+
+bool FileSource::open()
+{
+    close();
+
+    int fd = ::open(settings_.path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Source: unable to open frame file '" << settings_.path << "'" << std::endl;
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t) file_stat.st_size < sizeof(header_)) {
+        std::cout << "Source: '" << settings_.path << "' is not a frame file" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    mapping_size_ = (size_t) file_stat.st_size;
+    void *mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cout << "Source: unable to map frame file '" << settings_.path << "'" << std::endl;
+        return false;
+    }
+    mapping_ = (unsigned char *) mapping;
+    madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+    std::memcpy(&header_, mapping_, sizeof(header_));
+    int bytes_per_pixel = PixelFormat::bytesPerPixel((PixelFormat::Format) header_.format);
+    if (std::memcmp(header_.magic, MAGIC, 4) != 0 || header_.version != VERSION || bytes_per_pixel == 0 ||
+        header_.stride < header_.width * (uint32_t) bytes_per_pixel) {
+        std::cout << "Source: '" << settings_.path << "' is not a frame file" << std::endl;
+        close();
+        return false;
+    }
+
+    // an interrupted recording has no frame count yet, use what is complete
+    record_size_ = sizeof(uint64_t) + (size_t) header_.stride * header_.height;
+    uint32_t complete_frames = (uint32_t) ((mapping_size_ - sizeof(header_)) / record_size_);
+    if (header_.frame_count == 0 || header_.frame_count > complete_frames)
+        header_.frame_count = complete_frames;
+
+    if (header_.frame_count == 0) {
+        std::cout << "Source: '" << settings_.path << "' contains no frames" << std::endl;
+        close();
+        return false;
+    }
+
+    next_frame_ = 0;
+    std::cout << "Source: playing " << header_.frame_count << " frames of " << header_.width << "x" << header_.height
+              << " from '" << settings_.path << "'" << (settings_.realtime ? " at recorded rate" : "") << std::endl;
+    return true;
+}
+
+void FileSource::close()
+{
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+    mapping_size_ = 0;
+}
+
+const char *FileSource::name() const
+{
+    return "file";
+}
+
+int FileSource::width() const
+{
+    return (int) header_.width;
+}
+
+int FileSource::height() const
+{
+    return (int) header_.height;
+}
+
+PixelFormat::Format FileSource::format() const
+{
+    return (PixelFormat::Format) header_.format;
+}
+
+FrameSource::Result FileSource::acquireFrame(SourceFrame *frame)
+{
+    if (!mapping_)
+        return FAILED;
+
+    // end of the sequence, start over
+    if (next_frame_ >= header_.frame_count)
+        next_frame_ = 0;
+
+    const unsigned char *record = frameRecord(next_frame_);
+    uint64_t timestamp;
+    std::memcpy(&timestamp, record, sizeof(timestamp));
+
+    if (next_frame_ == 0) {
+        first_timestamp_ = timestamp;
+        start_time_ = std::chrono::steady_clock::now();
+    }
+
+    readahead(next_frame_ + 1);
+
+    // keep the recorded distance between frames
+    if (settings_.realtime && timestamp > first_timestamp_)
+        std::this_thread::sleep_until(start_time_ + std::chrono::nanoseconds(timestamp - first_timestamp_));
+
+    frame->pixels = record + sizeof(uint64_t);
+    frame->width = (int) header_.width;
+    frame->height = (int) header_.height;
+    frame->stride = (int) header_.stride;
+    frame->format = (PixelFormat::Format) header_.format;
+    frame->full = true;
+    frame->dirty.clear();
+
+    ++next_frame_;
+    return ACQUIRED;
+}
+
+const unsigned char *FileSource::frameRecord(uint32_t index) const
+{
+    return mapping_ + sizeof(header_) + record_size_ * index;
+}
+
+void FileSource::readahead(uint32_t index)
+{
+    // ask the kernel to page in the following frames while the current one is uploaded
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < READAHEAD_FRAMES; ++i) {
+        uint32_t frame = (index + (uint32_t) i) % header_.frame_count;
+        size_t offset = (size_t) (frameRecord(frame) - mapping_);
+        size_t aligned = offset - offset % (size_t) page_size;
+        madvise(mapping_ + aligned, record_size_ + (offset - aligned), MADV_WILLNEED);
+    }
+}
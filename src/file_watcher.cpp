@@ -0,0 +1,93 @@
+#include "../inc/file_watcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+FileWatcher::FileWatcher()
+        : fd_(-1),
+          watches_()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+    close();
+}
+
+bool FileWatcher::init()
+{
+    close();
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        std::cout << "Watch: inotify is not available, files are only reloaded on request" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    watches_.clear();
+}
+
+bool FileWatcher::watch(const std::string &path)
+{
+    if (fd_ < 0)
+        return false;
+
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, std::max(slash, (size_t) 1));
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    // a directory that is already watched returns the same descriptor
+    int descriptor = inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0) {
+        std::cout << "Watch: unable to watch '" << path << "'" << std::endl;
+        return false;
+    }
+
+    watches_.push_back({descriptor, name, path});
+    return true;
+}
+
+std::vector<std::string> FileWatcher::wait(int timeout_ms)
+{
+    std::vector<std::string> changed;
+    if (fd_ < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return changed;
+    }
+
+    pollfd poll_fd = {fd_, POLLIN, 0};
+    if (poll(&poll_fd, 1, timeout_ms) <= 0)
+        return changed;
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(fd_, buffer, sizeof(buffer))) > 0) {
+        for (char *position = buffer; position < buffer + length;) {
+            const auto *event = (const inotify_event *) position;
+            position += sizeof(inotify_event) + event->len;
+            if (event->len == 0)
+                continue;
+
+            for (const Watch &watch : watches_) {
+                if (watch.descriptor == event->wd && watch.name == event->name &&
+                    std::find(changed.begin(), changed.end(), watch.path) == changed.end())
+                    changed.push_back(watch.path);
+            }
+        }
+    }
+    return changed;
+}
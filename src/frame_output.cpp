@@ -0,0 +1,372 @@
+#include "../inc/frame_output.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// the file descriptor of stdout before the log was moved away from it
+int stdout_fd = -1;
+
+}
+
+const int FrameOutput::PIPE_RETRY_MS;
+
+FrameOutput::FrameOutput()
+        : path_(),
+          width_(0),
+          height_(0),
+          samples_(0),
+          depth_(false),
+          frame_size_(0),
+          framebuffer_(0),
+          color_buffer_(0),
+          depth_buffer_(0),
+          resolve_framebuffer_(0),
+          resolve_buffer_(0),
+          pixel_buffers_(),
+          fences_(),
+          next_buffer_(0),
+          pending_(0),
+          mutex_(),
+          queued_(),
+          frames_(),
+          free_frames_(),
+          queued_frames_(),
+          thread_(),
+          running_(false),
+          written_(0),
+          dropped_(0)
+{
+}
+
+FrameOutput::~FrameOutput()
+{
+    release();
+}
+
+bool FrameOutput::init(const std::string &path, int width, int height, int samples, bool depth)
+{
+    release();
+
+    path_ = path;
+    width_ = width;
+    height_ = height;
+    samples_ = samples;
+    depth_ = depth;
+    if (!createBuffers()) {
+        release();
+        return false;
+    }
+
+    frames_.assign(QUEUED_FRAMES, Frame());
+    for (int i = 0; i < QUEUED_FRAMES; ++i)
+        free_frames_.push_back(i);
+
+    if (path_ == "-")
+        takeStdout();
+
+    // a reader closing the pipe makes writes fail instead of terminating glwarp
+    std::signal(SIGPIPE, SIG_IGN);
+
+    running_ = true;
+    thread_ = std::thread(&FrameOutput::run, this);
+
+    std::cout << "Output: " << width_ << "x" << height_ << " BGRA frames to '" << path_ << "', " << samples_
+              << " samples, " << READBACK_BUFFERS << " readback buffers" << std::endl;
+    return true;
+}
+
+void FrameOutput::takeStdout()
+{
+    if (stdout_fd >= 0)
+        return;
+
+    std::cout.flush();
+    std::fflush(stdout);
+    stdout_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+}
+
+void FrameOutput::release()
+{
+    // the last frames are still written
+    if (pending_ > 0)
+        collect(true);
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        queued_.notify_all();
+        thread_.join();
+        std::cout << "Output: wrote " << written_ << " frames, " << dropped_ << " dropped" << std::endl;
+    }
+
+    releaseBuffers();
+    frames_.clear();
+    free_frames_.clear();
+    queued_frames_.clear();
+}
+
+void FrameOutput::resize(int width, int height)
+{
+    if (!thread_.joinable() || (width == width_ && height == height_))
+        return;
+
+    // readbacks in flight are of the old size, they are taken before their buffers go
+    if (pending_ > 0)
+        collect(true);
+    releaseBuffers();
+    width_ = width;
+    height_ = height;
+    // without a framebuffer rendering goes to the window and nothing more is written
+    if (createBuffers())
+        std::cout << "Output: resized to " << width_ << "x" << height_ << std::endl;
+}
+
+bool FrameOutput::createBuffers()
+{
+    frame_size_ = (size_t) width_ * height_ * 4;
+
+    glGenRenderbuffers(1, &color_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA8, width_, height_);
+    if (depth_) {
+        glGenRenderbuffers(1, &depth_buffer_);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_DEPTH_COMPONENT24, width_, height_);
+    }
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+    if (depth_buffer_)
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    // multisampled pixels can not be read directly, they are resolved into a single sampled copy first
+    if (samples_ > 0) {
+        glGenRenderbuffers(1, &resolve_buffer_);
+        glBindRenderbuffer(GL_RENDERBUFFER, resolve_buffer_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+        glGenFramebuffers(1, &resolve_framebuffer_);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolve_buffer_);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cout << "Output: unable to create a " << width_ << "x" << height_ << " framebuffer with " << samples_
+                  << " samples" << std::endl;
+        releaseBuffers();
+        return false;
+    }
+
+    glGenBuffers(READBACK_BUFFERS, pixel_buffers_);
+    for (GLuint buffer : pixel_buffers_) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_size_, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void FrameOutput::releaseBuffers()
+{
+    if (pixel_buffers_[0])
+        glDeleteBuffers(READBACK_BUFFERS, pixel_buffers_);
+    for (int i = 0; i < READBACK_BUFFERS; ++i)
+        pixel_buffers_[i] = 0;
+    if (framebuffer_)
+        glDeleteFramebuffers(1, &framebuffer_);
+    if (resolve_framebuffer_)
+        glDeleteFramebuffers(1, &resolve_framebuffer_);
+    GLuint renderbuffers[] = {color_buffer_, depth_buffer_, resolve_buffer_};
+    for (GLuint renderbuffer : renderbuffers) {
+        if (renderbuffer)
+            glDeleteRenderbuffers(1, &renderbuffer);
+    }
+    framebuffer_ = 0;
+    resolve_framebuffer_ = 0;
+    color_buffer_ = 0;
+    depth_buffer_ = 0;
+    resolve_buffer_ = 0;
+    next_buffer_ = 0;
+}
+
+void FrameOutput::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void FrameOutput::finishFrame()
+{
+    if (!framebuffer_)
+        return;
+
+    GLuint source = framebuffer_;
+    if (resolve_framebuffer_) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer_);
+        glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        source = resolve_framebuffer_;
+    }
+
+    // the projector shows exactly what is written
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    // with every buffer in flight the oldest is waited for, it is usually done long ago
+    if (pending_ == READBACK_BUFFERS)
+        collect(true);
+
+    // BGRA as packed 8_8_8_8_REV is the native layout of most drivers and read without conversion
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers_[next_buffer_]);
+    glReadPixels(0, 0, width_, height_, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, (void *) 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences_[next_buffer_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_buffer_ = (next_buffer_ + 1) % READBACK_BUFFERS;
+    ++pending_;
+
+    collect(false);
+}
+
+unsigned long FrameOutput::writtenCount() const
+{
+    return written_;
+}
+
+unsigned long FrameOutput::droppedCount() const
+{
+    return dropped_;
+}
+
+void FrameOutput::collect(bool wait)
+{
+    // readbacks complete in the order they were started
+    while (pending_ > 0) {
+        int index = (next_buffer_ + READBACK_BUFFERS - pending_) % READBACK_BUFFERS;
+        GLenum result = glClientWaitSync(fences_[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fences_[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (result == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(fences_[index]);
+        fences_[index] = nullptr;
+        --pending_;
+
+        int frame = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_frames_.empty()) {
+                frame = free_frames_.back();
+                free_frames_.pop_back();
+            }
+        }
+        if (frame < 0) {
+            ++dropped_;
+            continue;
+        }
+
+        // a free frame belongs to this thread, it takes the current size
+        frames_[frame].width = width_;
+        frames_[frame].height = height_;
+        frames_[frame].pixels.resize(frame_size_);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers_[index]);
+        auto pixels = (const unsigned char *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size_, GL_MAP_READ_BIT);
+        if (pixels)
+            std::memcpy(frames_[frame].pixels.data(), pixels, frame_size_);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pixels) {
+                queued_frames_.push_back(frame);
+            } else {
+                free_frames_.push_back(frame);
+                ++dropped_;
+            }
+        }
+        queued_.notify_one();
+    }
+}
+
+std::FILE *FrameOutput::openFile()
+{
+    if (path_ == "-")
+        return fdopen(dup(stdout_fd), "wb");
+
+    // a named pipe can only be opened for writing once it has a reader, until then the open is retried so
+    // release() is never stuck waiting for one
+    int fd = -1;
+    while ((fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0666)) < 0 && errno == ENXIO) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queued_.wait_for(lock, std::chrono::milliseconds(PIPE_RETRY_MS), [this]() { return !running_; })) {
+            std::cout << "Output: no reader opened '" << path_ << "'" << std::endl;
+            return nullptr;
+        }
+    }
+    if (fd < 0) {
+        std::cout << "Output: unable to open '" << path_ << "'" << std::endl;
+        return nullptr;
+    }
+
+    // writes block again, a slow reader holds up the writer thread and not rendering
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    std::FILE *file = fdopen(fd, "wb");
+    if (!file)
+        ::close(fd);
+    return file;
+}
+
+void FrameOutput::run()
+{
+    std::FILE *file = openFile();
+    if (file)
+        std::setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+    while (true) {
+        int frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this]() { return !running_ || !queued_frames_.empty(); });
+            // queued frames are written before stopping
+            if (queued_frames_.empty())
+                break;
+            frame = queued_frames_.front();
+            queued_frames_.pop_front();
+        }
+
+        // GL rows start at the bottom
+        bool written = file != nullptr;
+        const unsigned char *pixels = frames_[frame].pixels.data();
+        size_t stride = (size_t) frames_[frame].width * 4;
+        for (int y = frames_[frame].height - 1; y >= 0 && written; --y)
+            written = std::fwrite(pixels + y * stride, 1, stride, file) == stride;
+
+        if (written) {
+            ++written_;
+        } else {
+            if (file) {
+                std::cout << "Output: unable to write '" << path_ << "', no more frames are written" << std::endl;
+                std::fclose(file);
+                file = nullptr;
+            }
+            ++dropped_;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_frames_.push_back(frame);
+    }
+
+    if (file)
+        std::fclose(file);
+}
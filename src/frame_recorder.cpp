@@ -0,0 +1,117 @@
+#include "../inc/frame_recorder.h"
+#include "../inc/file_source.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::FrameRecorder()
+        : file_(nullptr),
+          path_(),
+          width_(0),
+          height_(0),
+          format_(PixelFormat::BGRA),
+          frame_count_(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open(const std::string &path, int width, int height, PixelFormat::Format format)
+{
+    close();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        std::cout << "Record: unable to create '" << path << "'" << std::endl;
+        return false;
+    }
+    // frames are large, write them in few big chunks
+    std::setvbuf(file_, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+    path_ = path;
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    frame_count_ = 0;
+
+    FrameFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FileSource::MAGIC, 4);
+    header.version = FileSource::VERSION;
+    header.width = (uint32_t) width;
+    header.height = (uint32_t) height;
+    header.stride = (uint32_t) (width * PixelFormat::bytesPerPixel(format));
+    header.format = (uint32_t) format;
+
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+        std::cout << "Record: unable to write '" << path << "'" << std::endl;
+        close();
+        return false;
+    }
+
+    std::cout << "Record: writing " << width << "x" << height << " " << PixelFormat::name(format) << " frames to '"
+              << path << "'" << std::endl;
+    return true;
+}
+
+void FrameRecorder::close()
+{
+    if (!file_)
+        return;
+
+    // patch the frame count now that it is known
+    uint32_t frame_count = (uint32_t) frame_count_;
+    if (std::fseek(file_, offsetof(FrameFileHeader, frame_count), SEEK_SET) != 0 ||
+        std::fwrite(&frame_count, sizeof(frame_count), 1, file_) != 1)
+        std::cout << "Record: unable to finish '" << path_ << "'" << std::endl;
+
+    std::fclose(file_);
+    file_ = nullptr;
+    std::cout << "Record: wrote " << frame_count_ << " frames to '" << path_ << "'" << std::endl;
+}
+
+bool FrameRecorder::isOpen() const
+{
+    return file_ != nullptr;
+}
+
+bool FrameRecorder::write(const SourceFrame &frame, uint64_t timestamp_ns)
+{
+    if (!file_)
+        return false;
+
+    if (frame.width != width_ || frame.height != height_ || frame.format != format_) {
+        std::cout << "Record: frame layout changed, recording stopped" << std::endl;
+        close();
+        return false;
+    }
+
+    bool written = std::fwrite(&timestamp_ns, sizeof(timestamp_ns), 1, file_) == 1;
+
+    // the file stores tightly packed rows, the source may pad them
+    size_t row_size = (size_t) width_ * PixelFormat::bytesPerPixel(format_);
+    if ((size_t) frame.stride == row_size) {
+        written = written && std::fwrite(frame.pixels, row_size * height_, 1, file_) == 1;
+    } else {
+        for (int y = 0; y < height_ && written; ++y)
+            written = std::fwrite(frame.pixels + (size_t) frame.stride * y, row_size, 1, file_) == 1;
+    }
+
+    if (!written) {
+        std::cout << "Record: unable to write '" << path_ << "', recording stopped" << std::endl;
+        close();
+        return false;
+    }
+
+    ++frame_count_;
+    return true;
+}
+
+unsigned long FrameRecorder::frameCount() const
+{
+    return frame_count_;
+}
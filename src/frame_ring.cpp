@@ -0,0 +1,67 @@
+#include "../inc/frame_ring.h"
+
+FrameRing::FrameRing()
+        : slots_(),
+          back_(0),
+          front_(1),
+          middle_(2),
+          published_(0),
+          dropped_(0),
+          reused_(0)
+{
+    for (Frame &slot : slots_) {
+        slot.width = 0;
+        slot.height = 0;
+        slot.stride = 0;
+        slot.format = PixelFormat::BGRA;
+        slot.sequence = 0;
+        slot.capture_start = 0;
+        slot.capture_end = 0;
+        slot.full = true;
+    }
+}
+
+Frame *FrameRing::writeSlot()
+{
+    return &slots_[back_];
+}
+
+void FrameRing::publish()
+{
+    slots_[back_].sequence = published_.load(std::memory_order_relaxed) + 1;
+
+    // hand the back slot over as newest frame and continue with whatever was in the middle
+    int previous = middle_.exchange(back_ | FRESH_BIT, std::memory_order_acq_rel);
+    if (previous & FRESH_BIT)
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+
+    back_ = previous & INDEX_MASK;
+    published_.fetch_add(1, std::memory_order_relaxed);
+}
+
+const Frame *FrameRing::acquire()
+{
+    if (!(middle_.load(std::memory_order_relaxed) & FRESH_BIT)) {
+        reused_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    int previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & INDEX_MASK;
+    return &slots_[front_];
+}
+
+unsigned long FrameRing::publishedCount() const
+{
+    return published_.load(std::memory_order_relaxed);
+}
+
+unsigned long FrameRing::droppedCount() const
+{
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+unsigned long FrameRing::reusedCount() const
+{
+    return reused_.load(std::memory_order_relaxed);
+}
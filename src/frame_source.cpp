@@ -0,0 +1,79 @@
+#include "../inc/frame_source.h"
+#include "../inc/x11_source.h"
+#include "../inc/file_source.h"
+#include "../inc/synthetic_source.h"
+#include "../inc/shm_ring_source.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+FrameSource::FrameSource()
+        : stats_()
+{
+}
+
+FrameSource::~FrameSource()
+{
+}
+
+FrameSource *FrameSource::create(const std::string &type, const FrameSourceSettings &settings)
+{
+    if (type == "shm")
+        return new ShmSource(settings);
+    if (type == "x11")
+        return new X11Source(settings);
+    if (type == "file")
+        return new FileSource(settings);
+    if (type == "synthetic")
+        return new SyntheticSource(settings);
+    if (type == "ring")
+        return new ShmRingSource(settings);
+
+    std::cout << "Source: unknown frame source '" << type << "'" << std::endl;
+    return nullptr;
+}
+
+FrameSource::Result FrameSource::acquire(SourceFrame *frame)
+{
+    auto start = std::chrono::steady_clock::now();
+    Result result = acquireFrame(frame);
+    stats_.acquire_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result == ACQUIRED)
+        ++stats_.acquired;
+    else if (result == UNCHANGED)
+        ++stats_.unchanged;
+    else
+        ++stats_.failed;
+    return result;
+}
+
+bool FrameSource::frameIntact()
+{
+    return true;
+}
+
+void FrameSource::release()
+{
+}
+
+bool FrameSource::framesInPlace() const
+{
+    return false;
+}
+
+void FrameSource::waitForFrame(double timeout_seconds)
+{
+    std::this_thread::sleep_for(std::chrono::duration<double>(timeout_seconds));
+}
+
+PixelFormat::Format FrameSource::format() const
+{
+    return PixelFormat::BGRA;
+}
+
+const FrameSourceStats &FrameSource::stats() const
+{
+    return stats_;
+}
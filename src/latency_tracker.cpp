@@ -0,0 +1,259 @@
+#include "../inc/latency_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const uint64_t CALIBRATION_INTERVAL = 1000000000ull;
+
+struct Metric {
+    const char *name;
+    uint64_t LatencyTracker::Sample::*from;
+    uint64_t LatencyTracker::Sample::*to;
+};
+
+const Metric METRICS[] = {
+        {"capture to swap", &LatencyTracker::Sample::capture_start, &LatencyTracker::Sample::swap_return},
+        {"capture", &LatencyTracker::Sample::capture_start, &LatencyTracker::Sample::capture_end},
+        {"queued", &LatencyTracker::Sample::capture_end, &LatencyTracker::Sample::upload_submit},
+        {"upload and draw", &LatencyTracker::Sample::upload_submit, &LatencyTracker::Sample::draw_submit},
+        {"draw to swap", &LatencyTracker::Sample::draw_submit, &LatencyTracker::Sample::swap_return},
+        {"gpu", &LatencyTracker::Sample::gpu_start, &LatencyTracker::Sample::gpu_end}
+};
+
+double percentile(const std::vector<double> &sorted, double fraction)
+{
+    size_t rank = (size_t) (fraction * (double) (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+}
+
+LatencyTracker::LatencyTracker()
+        : samples_(),
+          written_(0),
+          current_(),
+          displayed_(),
+          pending_(),
+          queries_(),
+          pending_head_(0),
+          pending_count_(0),
+          gpu_offset_(0),
+          last_calibration_(0),
+          dump_thread_()
+{
+}
+
+LatencyTracker::~LatencyTracker()
+{
+    release();
+}
+
+bool LatencyTracker::init(size_t capacity)
+{
+    release();
+
+    samples_.assign(std::max(capacity, (size_t) 1), Sample());
+    written_ = 0;
+    std::memset(&displayed_, 0, sizeof(displayed_));
+    pending_head_ = 0;
+    pending_count_ = 0;
+
+    glGenQueries(QUERY_FRAMES * 2, &queries_[0][0]);
+    calibrate();
+
+    std::cout << "Latency: tracking the last " << samples_.size() << " frames" << std::endl;
+    return true;
+}
+
+void LatencyTracker::release()
+{
+    if (dump_thread_.joinable())
+        dump_thread_.join();
+
+    if (!samples_.empty()) {
+        glDeleteQueries(QUERY_FRAMES * 2, &queries_[0][0]);
+        samples_.clear();
+    }
+    pending_count_ = 0;
+}
+
+uint64_t LatencyTracker::now()
+{
+    auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+void LatencyTracker::beginFrame()
+{
+    // make room for this frame's queries, normally the oldest frame finished long ago
+    if (pending_count_ == QUERY_FRAMES)
+        resolvePending(true);
+
+    int slot = (pending_head_ + pending_count_) % QUERY_FRAMES;
+    glQueryCounter(queries_[slot][0], GL_TIMESTAMP);
+
+    current_ = displayed_;
+    current_.fresh = false;
+    current_.upload_submit = 0;
+}
+
+void LatencyTracker::uploadStarted()
+{
+    // taken after the frame was acquired, a frame captured in the meantime still ends before it
+    current_.upload_submit = now();
+}
+
+void LatencyTracker::frameUploaded(const Frame &frame)
+{
+    displayed_.sequence = frame.sequence;
+    displayed_.capture_start = frame.capture_start;
+    displayed_.capture_end = frame.capture_end;
+
+    current_.sequence = frame.sequence;
+    current_.capture_start = frame.capture_start;
+    current_.capture_end = frame.capture_end;
+    current_.fresh = true;
+}
+
+void LatencyTracker::drawSubmitted()
+{
+    int slot = (pending_head_ + pending_count_) % QUERY_FRAMES;
+    glQueryCounter(queries_[slot][1], GL_TIMESTAMP);
+    current_.draw_submit = now();
+}
+
+void LatencyTracker::endFrame()
+{
+    current_.swap_return = now();
+
+    // the GPU times are filled in once the queries finished
+    pending_[(pending_head_ + pending_count_) % QUERY_FRAMES] = current_;
+    ++pending_count_;
+    resolvePending(false);
+
+    if (current_.swap_return - last_calibration_ > CALIBRATION_INTERVAL)
+        calibrate();
+}
+
+std::vector<LatencyTracker::Sample> LatencyTracker::snapshot() const
+{
+    std::vector<Sample> result;
+    if (samples_.empty())
+        return result;
+
+    uint64_t capacity = samples_.size();
+    uint64_t begin = written_ > capacity ? written_ - capacity : 0;
+    result.reserve((size_t) (written_ - begin));
+    for (uint64_t i = begin; i < written_; ++i)
+        result.push_back(samples_[(size_t) (i % capacity)]);
+    return result;
+}
+
+void LatencyTracker::printSummary() const
+{
+    std::vector<Sample> samples = snapshot();
+    if (samples.empty())
+        return;
+
+    std::cout << "latency over " << samples.size() << " frames (p50 / p95 / p99 ms):" << std::endl;
+    for (const Metric &metric : METRICS) {
+        std::vector<double> values;
+        values.reserve(samples.size());
+        for (const Sample &sample : samples) {
+            uint64_t from = sample.*metric.from;
+            uint64_t to = sample.*metric.to;
+            if (from != 0 && to >= from)
+                values.push_back((double) (to - from) / 1000000.0);
+        }
+        if (values.empty())
+            continue;
+
+        std::sort(values.begin(), values.end());
+        std::cout << "  " << std::left << std::setw(16) << metric.name << std::right << std::fixed
+                  << std::setprecision(2) << percentile(values, 0.5) << " / " << percentile(values, 0.95) << " / "
+                  << percentile(values, 0.99) << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+}
+
+bool LatencyTracker::writeCSV(const std::string &path) const
+{
+    return writeSamples(path, snapshot());
+}
+
+void LatencyTracker::dumpCSV(const std::string &path)
+{
+    if (dump_thread_.joinable())
+        dump_thread_.join();
+    // the copy is taken here, the ring keeps being written while the file is
+    std::vector<Sample> samples = snapshot();
+    dump_thread_ = std::thread([path, samples]() { writeSamples(path, samples); });
+}
+
+bool LatencyTracker::writeSamples(const std::string &path, const std::vector<Sample> &samples)
+{
+    std::ofstream file(path);
+    if (!file.good()) {
+        std::cout << "Latency: unable to write '" << path << "'" << std::endl;
+        return false;
+    }
+
+    file << "sequence,fresh,capture_start_ns,capture_end_ns,upload_submit_ns,draw_submit_ns,swap_return_ns,"
+            "gpu_start_ns,gpu_end_ns\n";
+    for (const Sample &sample : samples) {
+        file << sample.sequence << ',' << (sample.fresh ? 1 : 0) << ',' << sample.capture_start << ','
+             << sample.capture_end << ',' << sample.upload_submit << ',' << sample.draw_submit << ','
+             << sample.swap_return << ',' << sample.gpu_start << ',' << sample.gpu_end << '\n';
+    }
+
+    std::cout << "Latency: wrote " << samples.size() << " frames to '" << path << "'" << std::endl;
+    return file.good();
+}
+
+void LatencyTracker::publish(const Sample &sample)
+{
+    samples_[(size_t) (written_ % samples_.size())] = sample;
+    ++written_;
+}
+
+void LatencyTracker::resolvePending(bool wait)
+{
+    while (pending_count_ > 0) {
+        GLuint *queries = queries_[pending_head_];
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+        }
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+
+        Sample &sample = pending_[pending_head_];
+        sample.gpu_start = (uint64_t) ((int64_t) start + gpu_offset_);
+        sample.gpu_end = (uint64_t) ((int64_t) end + gpu_offset_);
+        publish(sample);
+
+        pending_head_ = (pending_head_ + 1) % QUERY_FRAMES;
+        --pending_count_;
+        wait = false;
+    }
+}
+
+void LatencyTracker::calibrate()
+{
+    // the GL clock is read without waiting for queued commands, which keeps the offset accurate to microseconds
+    GLint64 gpu_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+    last_calibration_ = now();
+    gpu_offset_ = (int64_t) last_calibration_ - (int64_t) gpu_time;
+}
@@ -0,0 +1,138 @@
+#include "../inc/mesh_builder.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+MeshBuilder::MeshBuilder(int rings, int points_per_ring)
+        : rings_(rings),
+          points_per_ring_(points_per_ring)
+{
+}
+
+bool MeshBuilder::isValid() const
+{
+    return rings_ >= 1 && points_per_ring_ >= 3 && vertexCount() <= 0xffffffffu;
+}
+
+size_t MeshBuilder::vertexCount() const
+{
+    return 1 + (size_t) rings_ * (size_t) points_per_ring_;
+}
+
+size_t MeshBuilder::indexCount() const
+{
+    // a fan around the center and two triangles per quad between neighbouring rings
+    return ((size_t) points_per_ring_ + (size_t) (rings_ - 1) * points_per_ring_ * 2) * 3;
+}
+
+bool MeshBuilder::build(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &uvs,
+                        std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices, int threads) const
+{
+    if (!isValid() || positions.size() != vertexCount() || uvs.size() != vertexCount()) {
+        std::cout << "Mesh: " << positions.size() << " points do not form " << rings_ << " rings of "
+                  << points_per_ring_ << std::endl;
+        return false;
+    }
+
+    vertices->resize(vertexCount());
+    indices->resize(indexCount());
+
+    if (threads <= 0)
+        threads = (int) std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::max(std::min(threads, rings_ / MIN_RINGS_PER_THREAD), 1);
+
+    if (threads == 1) {
+        buildRings(positions, uvs, vertices->data(), indices->data(), 0, rings_);
+        return true;
+    }
+
+    // every thread writes a disjoint range of rings, nothing is shared
+    std::vector<std::thread> workers;
+    workers.reserve((size_t) threads - 1);
+    for (int t = 1; t < threads; ++t) {
+        int first_ring = (int) ((long) rings_ * t / threads);
+        int last_ring = (int) ((long) rings_ * (t + 1) / threads);
+        workers.emplace_back(&MeshBuilder::buildRings, this, std::cref(positions), std::cref(uvs),
+                             vertices->data(), indices->data(), first_ring, last_ring);
+    }
+    buildRings(positions, uvs, vertices->data(), indices->data(), 0, rings_ / threads);
+
+    for (std::thread &worker : workers)
+        worker.join();
+    return true;
+}
+
+void MeshBuilder::buildIndices(std::vector<uint32_t> *indices) const
+{
+    indices->resize(isValid() ? indexCount() : 0);
+    if (!indices->empty())
+        buildRingIndices(indices->data(), 0, rings_);
+}
+
+int MeshBuilder::rings() const
+{
+    return rings_;
+}
+
+int MeshBuilder::pointsPerRing() const
+{
+    return points_per_ring_;
+}
+
+void MeshBuilder::buildRings(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &uvs,
+                             WarpVertex *vertices, uint32_t *indices, int first_ring, int last_ring) const
+{
+    auto ring_size = (uint32_t) points_per_ring_;
+
+    // ring r owns its points and the triangles connecting it to the ring inside, ring 0 also owns the center
+    size_t first_vertex = first_ring == 0 ? 0 : 1 + (size_t) first_ring * ring_size;
+    size_t last_vertex = 1 + (size_t) last_ring * ring_size;
+    for (size_t i = first_vertex; i < last_vertex; ++i) {
+        WarpVertex &vertex = vertices[i];
+        vertex.x = positions[i].x;
+        vertex.y = positions[i].y;
+        vertex.z = positions[i].z;
+        vertex.u = uvs[i].x;
+        vertex.v = uvs[i].y;
+    }
+
+    buildRingIndices(indices, first_ring, last_ring);
+}
+
+void MeshBuilder::buildRingIndices(uint32_t *indices, int first_ring, int last_ring) const
+{
+    auto ring_size = (uint32_t) points_per_ring_;
+
+    uint32_t *index = indices;
+    if (first_ring == 0) {
+        // triangle fan around the center
+        for (uint32_t t = 1; t < ring_size + 1; ++t) {
+            *index++ = 0;
+            *index++ = t;
+            *index++ = 1 + (t % ring_size);
+        }
+        first_ring = 1;
+    } else {
+        index += ((size_t) ring_size + (size_t) (first_ring - 1) * ring_size * 2) * 3;
+    }
+
+    // two triangles per quad between the ring and the one inside
+    for (int ring = first_ring; ring < last_ring; ++ring) {
+        uint32_t start_point = 1 + (uint32_t) (ring - 1) * ring_size;
+        for (uint32_t idx = 0; idx < ring_size; ++idx) {
+            uint32_t inner = start_point + idx;
+            uint32_t inner_next = start_point + (idx + 1) % ring_size;
+            uint32_t outer = inner + ring_size;
+            uint32_t outer_next = inner_next + ring_size;
+
+            *index++ = inner;
+            *index++ = outer;
+            *index++ = inner_next;
+
+            *index++ = inner_next;
+            *index++ = outer;
+            *index++ = outer_next;
+        }
+    }
+}
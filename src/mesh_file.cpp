@@ -0,0 +1,178 @@
+#include "../inc/mesh_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char MeshFile::MAGIC[4] = {'G', 'W', 'M', 'S'};
+
+namespace {
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + 15) & ~(uint64_t) 15;
+}
+
+bool writePadding(std::FILE *file, uint64_t from, uint64_t to)
+{
+    static const char zeros[16] = {};
+    return to == from || std::fwrite(zeros, (size_t) (to - from), 1, file) == 1;
+}
+
+template<typename T>
+bool indicesInRange(const T *indices, uint32_t index_count, uint32_t vertex_count)
+{
+    for (uint32_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count)
+            return false;
+    }
+    return true;
+}
+
+}
+
+MeshFile::MeshFile()
+        : mapping_(nullptr),
+          mapping_size_(0),
+          header_()
+{
+}
+
+MeshFile::~MeshFile()
+{
+    close();
+}
+
+bool MeshFile::write(const std::string &path, int rings, int points_per_ring, const std::vector<WarpVertex> &vertices,
+                     const std::vector<uint32_t> *indices, uint32_t flags)
+{
+    MeshFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.rings = (uint32_t) rings;
+    header.points_per_ring = (uint32_t) points_per_ring;
+    header.vertex_count = (uint32_t) vertices.size();
+    header.index_count = indices ? (uint32_t) indices->size() : 0;
+    header.index_size = vertices.size() <= 0x10000 ? 2 : 4;
+    header.flags = flags;
+    header.vertex_offset = align(sizeof(header));
+    header.index_offset = align(header.vertex_offset + vertices.size() * sizeof(WarpVertex));
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Mesh: unable to create '" << path << "'" << std::endl;
+        return false;
+    }
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   writePadding(file, sizeof(header), header.vertex_offset) &&
+                   std::fwrite(vertices.data(), sizeof(WarpVertex), vertices.size(), file) == vertices.size();
+
+    if (written && indices) {
+        written = writePadding(file, header.vertex_offset + vertices.size() * sizeof(WarpVertex),
+                               header.index_offset);
+        if (header.index_size == 2) {
+            std::vector<uint16_t> short_indices(indices->begin(), indices->end());
+            written = written && std::fwrite(short_indices.data(), sizeof(uint16_t), short_indices.size(), file) ==
+                                 short_indices.size();
+        } else {
+            written = written && std::fwrite(indices->data(), sizeof(uint32_t), indices->size(), file) ==
+                                 indices->size();
+        }
+    }
+
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+        std::cout << "Mesh: unable to write '" << path << "'" << std::endl;
+    return written;
+}
+
+bool MeshFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Mesh: unable to open '" << path << "'" << std::endl;
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t) file_stat.st_size < sizeof(header_)) {
+        std::cout << "Mesh: '" << path << "' is not a binary mesh" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    mapping_size_ = (size_t) file_stat.st_size;
+    void *mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cout << "Mesh: unable to map '" << path << "'" << std::endl;
+        return false;
+    }
+    mapping_ = (unsigned char *) mapping;
+
+    std::memcpy(&header_, mapping_, sizeof(header_));
+    MeshBuilder layout((int) header_.rings, (int) header_.points_per_ring);
+    uint64_t vertex_end = header_.vertex_offset + (uint64_t) header_.vertex_count * sizeof(WarpVertex);
+    uint64_t index_end = header_.index_offset + (uint64_t) header_.index_count * header_.index_size;
+
+    bool valid = std::memcmp(header_.magic, MAGIC, 4) == 0 && header_.version == VERSION && layout.isValid() &&
+                 header_.vertex_count == layout.vertexCount() && header_.vertex_offset % 16 == 0 &&
+                 header_.index_offset % 16 == 0 && vertex_end <= mapping_size_ &&
+                 (header_.index_count == 0 ||
+                  (header_.index_count == layout.indexCount() && index_end <= mapping_size_ &&
+                   header_.index_size == (header_.vertex_count <= 0x10000 ? 2u : 4u)));
+    if (!valid) {
+        std::cout << "Mesh: '" << path << "' is not a valid binary mesh" << std::endl;
+        close();
+        return false;
+    }
+
+    // everything is read soon, the indices right away
+    madvise(mapping_, mapping_size_, MADV_WILLNEED);
+
+    // every user of the mesh indexes the vertices with them, from the edge attribute to the GPU
+    const unsigned char *indices = mapping_ + header_.index_offset;
+    bool in_range = header_.index_size == 2
+                    ? indicesInRange((const uint16_t *) indices, header_.index_count, header_.vertex_count)
+                    : indicesInRange((const uint32_t *) indices, header_.index_count, header_.vertex_count);
+    if (!in_range) {
+        std::cout << "Mesh: '" << path << "' has indices beyond its " << header_.vertex_count << " vertices"
+                  << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MeshFile::close()
+{
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+    mapping_size_ = 0;
+}
+
+const MeshFileHeader &MeshFile::header() const
+{
+    return header_;
+}
+
+const WarpVertex *MeshFile::vertices() const
+{
+    return mapping_ ? (const WarpVertex *) (mapping_ + header_.vertex_offset) : nullptr;
+}
+
+const void *MeshFile::indices() const
+{
+    return mapping_ && header_.index_count > 0 ? mapping_ + header_.index_offset : nullptr;
+}
@@ -0,0 +1,74 @@
+#include "../inc/mesh_loader.h"
+#include "../inc/file_io.h"
+#include "../inc/mesh_file.h"
+#include "../inc/mesh_optimizer.h"
+
+#include <iostream>
+
+bool MeshLoader::isBinary(const std::string &path)
+{
+    const std::string extension = ".wmesh";
+    return path.size() > extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool MeshLoader::load(const std::string &mesh_path, const std::string &tex_path, bool optimize,
+                      WarpMeshData *data)
+{
+    if (isBinary(mesh_path)) {
+        MeshFile file;
+        if (!file.open(mesh_path))
+            return false;
+
+        const MeshFileHeader &header = file.header();
+        data->vertices.assign(file.vertices(), file.vertices() + header.vertex_count);
+        if (header.index_count > 0 && header.index_size == sizeof(uint16_t)) {
+            auto indices = (const uint16_t *) file.indices();
+            data->indices.assign(indices, indices + header.index_count);
+        } else if (header.index_count > 0) {
+            auto indices = (const uint32_t *) file.indices();
+            data->indices.assign(indices, indices + header.index_count);
+        } else {
+            MeshBuilder((int) header.rings, (int) header.points_per_ring).buildIndices(&data->indices);
+        }
+
+        if (optimize && !(header.flags & MeshFile::FLAG_OPTIMIZED))
+            MeshLoader::optimize(&data->vertices, &data->indices);
+        return true;
+    }
+
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> uvs;
+    MeshLayout layout;
+    MeshLayout uv_layout;
+    if (!FileIO::loadMesh(mesh_path.c_str(), &points, &layout) ||
+        !FileIO::loadMesh(tex_path.c_str(), &uvs, &uv_layout)) {
+        std::cout << "Mesh: unable to load mesh" << std::endl;
+        return false;
+    }
+
+    if (uvs.size() != points.size()) {
+        std::cout << "Warp points do not match" << std::endl;
+        return false;
+    }
+
+    MeshBuilder builder(layout.rings, layout.points_per_ring);
+    if (!builder.build(points, uvs, &data->vertices, &data->indices, 0))
+        return false;
+
+    if (optimize)
+        MeshLoader::optimize(&data->vertices, &data->indices);
+    return true;
+}
+
+void MeshLoader::optimize(std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices)
+{
+    auto vertex_count = (int) vertices->size();
+    double before = MeshOptimizer::acmr(*indices, vertex_count, MeshOptimizer::CACHE_SIZE);
+
+    *indices = MeshOptimizer::optimizeVertexCache(*indices, vertex_count);
+    MeshOptimizer::optimizeVertexFetch(vertices, indices);
+
+    double after = MeshOptimizer::acmr(*indices, vertex_count, MeshOptimizer::CACHE_SIZE);
+    std::cout << "Mesh: vertex cache miss ratio " << before << " -> " << after << " per triangle" << std::endl;
+}
@@ -0,0 +1,211 @@
+#include "../inc/mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// scoring constants of the original description
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+const int MAX_CACHE = MeshOptimizer::CACHE_SIZE;
+
+struct VertexState {
+    int cache_position;
+    int remaining;
+    float score;
+};
+
+// valences above this share the boost of the last entry, it is practically zero there
+const int MAX_VALENCE = 32;
+
+struct ScoreTables {
+    float cache[MAX_CACHE];
+    float valence[MAX_VALENCE + 1];
+
+    ScoreTables()
+    {
+        for (int i = 0; i < MAX_CACHE; ++i) {
+            if (i < 3) {
+                // the vertices of the last triangle get a fixed score, so that strips are not favoured too much
+                cache[i] = LAST_TRIANGLE_SCORE;
+            } else {
+                float scale = 1.0f / (float) (MAX_CACHE - 3);
+                cache[i] = std::pow(1.0f - (float) (i - 3) * scale, CACHE_DECAY_POWER);
+            }
+        }
+
+        // vertices with few triangles left are finished first so they leave the cache for good
+        valence[0] = 0.0f;
+        for (int i = 1; i <= MAX_VALENCE; ++i)
+            valence[i] = VALENCE_BOOST_SCALE * std::pow((float) i, -VALENCE_BOOST_POWER);
+    }
+};
+
+float vertexScore(const VertexState &vertex)
+{
+    static const ScoreTables tables;
+    if (vertex.remaining == 0)
+        return -1.0f;
+
+    float score = vertex.cache_position >= 0 ? tables.cache[vertex.cache_position] : 0.0f;
+    return score + tables.valence[std::min(vertex.remaining, MAX_VALENCE)];
+}
+
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t> &indices, int vertex_count)
+{
+    size_t triangle_count = indices.size() / 3;
+    std::vector<uint32_t> result;
+    result.reserve(triangle_count * 3);
+
+    // triangles around every vertex, as offsets into one shared array
+    std::vector<VertexState> vertices((size_t) vertex_count, VertexState{-1, 0, 0.0f});
+    for (uint32_t index : indices)
+        ++vertices[index].remaining;
+
+    std::vector<size_t> first_triangle((size_t) vertex_count + 1, 0);
+    for (int v = 0; v < vertex_count; ++v)
+        first_triangle[v + 1] = first_triangle[v] + (size_t) vertices[v].remaining;
+
+    std::vector<size_t> vertex_triangles(indices.size());
+    std::vector<size_t> filled(first_triangle.begin(), first_triangle.end() - 1);
+    for (size_t t = 0; t < triangle_count; ++t)
+        for (int c = 0; c < 3; ++c)
+            vertex_triangles[filled[indices[t * 3 + c]]++] = t;
+
+    for (VertexState &vertex : vertices)
+        vertex.score = vertexScore(vertex);
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    for (size_t t = 0; t < triangle_count; ++t)
+        triangle_scores[t] = vertices[indices[t * 3]].score + vertices[indices[t * 3 + 1]].score +
+                             vertices[indices[t * 3 + 2]].score;
+
+    // LRU cache, three more entries than its size to hold the vertices pushed out by the newest triangle
+    std::vector<uint32_t> cache;
+    cache.reserve(MAX_CACHE + 3);
+    std::vector<uint32_t> next_cache;
+    next_cache.reserve(MAX_CACHE + 3);
+
+    size_t scan_position = 0;
+    long best = -1;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        if (best < 0) {
+            // nothing in the cache references an open triangle, continue with the best remaining one
+            float best_score = -1.0f;
+            for (size_t t = scan_position; t < triangle_count; ++t) {
+                if (!emitted[t] && triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = (long) t;
+                }
+            }
+            while (scan_position < triangle_count && emitted[scan_position])
+                ++scan_position;
+        }
+
+        size_t triangle = (size_t) best;
+        emitted[triangle] = true;
+        const uint32_t *corners = &indices[triangle * 3];
+        result.insert(result.end(), corners, corners + 3);
+
+        // the triangle's vertices move to the front of the cache
+        next_cache.assign(corners, corners + 3);
+        for (uint32_t vertex : cache)
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+                next_cache.push_back(vertex);
+
+        for (int c = 0; c < 3; ++c) {
+            VertexState &state = vertices[corners[c]];
+            size_t begin = first_triangle[corners[c]];
+            size_t end = begin + (size_t) state.remaining;
+            // move the emitted triangle out of the open range of the vertex
+            for (size_t i = begin; i < end; ++i) {
+                if (vertex_triangles[i] == triangle) {
+                    std::swap(vertex_triangles[i], vertex_triangles[end - 1]);
+                    break;
+                }
+            }
+            --state.remaining;
+        }
+
+        // rescore everything in the cache and the triangles using it
+        for (size_t i = 0; i < next_cache.size(); ++i) {
+            VertexState &state = vertices[next_cache[i]];
+            state.cache_position = i < (size_t) MAX_CACHE ? (int) i : -1;
+            float old_score = state.score;
+            state.score = vertexScore(state);
+            float delta = state.score - old_score;
+
+            size_t begin = first_triangle[next_cache[i]];
+            for (size_t j = begin; j < begin + (size_t) state.remaining; ++j)
+                triangle_scores[vertex_triangles[j]] += delta;
+        }
+
+        best = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < next_cache.size() && i < (size_t) MAX_CACHE; ++i) {
+            const VertexState &state = vertices[next_cache[i]];
+            size_t begin = first_triangle[next_cache[i]];
+            for (size_t j = begin; j < begin + (size_t) state.remaining; ++j) {
+                size_t candidate = vertex_triangles[j];
+                if (triangle_scores[candidate] > best_score) {
+                    best_score = triangle_scores[candidate];
+                    best = (long) candidate;
+                }
+            }
+        }
+
+        if (next_cache.size() > (size_t) MAX_CACHE)
+            next_cache.resize(MAX_CACHE);
+        cache.swap(next_cache);
+    }
+
+    return result;
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<WarpVertex> *vertices, std::vector<uint32_t> *indices)
+{
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices->size(), unused);
+    std::vector<WarpVertex> reordered;
+    reordered.reserve(vertices->size());
+
+    // vertices in the order the triangles first reference them
+    for (uint32_t &index : *indices) {
+        if (remap[index] == unused) {
+            remap[index] = (uint32_t) reordered.size();
+            reordered.push_back((*vertices)[index]);
+        }
+        index = remap[index];
+    }
+
+    // points no triangle uses stay at the end
+    for (size_t v = 0; v < vertices->size(); ++v)
+        if (remap[v] == unused)
+            reordered.push_back((*vertices)[v]);
+
+    vertices->swap(reordered);
+}
+
+double MeshOptimizer::acmr(const std::vector<uint32_t> &indices, int vertex_count, int cache_size)
+{
+    if (indices.size() < 3)
+        return 0.0;
+
+    // FIFO cache as most GPUs implement it, a vertex is in the cache if it entered less than cache_size misses ago
+    std::vector<long> entered((size_t) vertex_count, -1);
+    long misses = 0;
+    for (uint32_t index : indices) {
+        if (entered[index] < 0 || misses - entered[index] >= cache_size) {
+            entered[index] = misses;
+            ++misses;
+        }
+    }
+    return (double) misses / (double) (indices.size() / 3);
+}
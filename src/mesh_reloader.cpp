@@ -0,0 +1,170 @@
+#include "../inc/mesh_reloader.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+const int MeshReloader::SETTLE_MS;
+
+MeshReloader::MeshReloader()
+        : mesh_path_(),
+          tex_path_(),
+          config_path_(),
+          optimize_(false),
+          generate_(false),
+          generator_(),
+          watcher_(),
+          mutex_(),
+          mesh_(),
+          config_(),
+          mesh_ready_(false),
+          config_ready_(false),
+          requested_(false),
+          thread_(),
+          running_(false)
+{
+}
+
+MeshReloader::~MeshReloader()
+{
+    stop();
+}
+
+bool MeshReloader::start(const std::string &mesh_path, const std::string &tex_path, const std::string &config_path,
+                         bool optimize, bool watch, bool generate)
+{
+    stop();
+
+    mesh_path_ = mesh_path;
+    tex_path_ = tex_path;
+    config_path_ = config_path;
+    optimize_ = optimize;
+    generate_ = generate;
+    if (generate_ && !generator_)
+        generator_.reset(new WarpGenerator());
+
+    if (watch && watcher_.init()) {
+        if (!generate_) {
+            watcher_.watch(mesh_path_);
+            if (!MeshLoader::isBinary(mesh_path_))
+                watcher_.watch(tex_path_);
+        }
+        if (!config_path_.empty())
+            watcher_.watch(config_path_);
+        std::cout << "Reload: watching '" << (generate_ ? config_path_ : mesh_path_) << "' for changes" << std::endl;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&MeshReloader::run, this);
+    return true;
+}
+
+void MeshReloader::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+    watcher_.close();
+}
+
+void MeshReloader::request()
+{
+    requested_ = true;
+}
+
+bool MeshReloader::takeMesh(WarpMeshData *data)
+{
+    if (!mesh_ready_)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(*data, mesh_);
+    mesh_ready_ = false;
+    return true;
+}
+
+bool MeshReloader::takeConfig(json11::Json *config)
+{
+    if (!config_ready_)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    *config = config_;
+    config_ready_ = false;
+    return true;
+}
+
+void MeshReloader::run()
+{
+    // short waits keep stop() responsive
+    const int poll_ms = 50;
+
+    while (running_) {
+        std::vector<std::string> changed = watcher_.wait(poll_ms);
+        if (changed.empty() && !requested_)
+            continue;
+
+        // wait until the files stopped changing
+        auto settled = std::chrono::steady_clock::now() + std::chrono::milliseconds(SETTLE_MS);
+        while (running_ && std::chrono::steady_clock::now() < settled) {
+            std::vector<std::string> more = watcher_.wait(poll_ms);
+            if (!more.empty()) {
+                changed.insert(changed.end(), more.begin(), more.end());
+                settled = std::chrono::steady_clock::now() + std::chrono::milliseconds(SETTLE_MS);
+            }
+        }
+
+        bool all = requested_.exchange(false);
+        bool mesh = all;
+        bool config = all;
+        for (const std::string &path : changed) {
+            mesh = mesh || path == mesh_path_ || path == tex_path_;
+            config = config || path == config_path_;
+        }
+        if (running_)
+            reload(mesh, config);
+    }
+}
+
+void MeshReloader::reload(bool mesh, bool config)
+{
+    json11::Json json;
+    bool config_loaded = false;
+    if (config && !config_path_.empty()) {
+        std::ifstream ifs(config_path_);
+        std::string str((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::string error;
+        json = json11::Json::parse(str, error);
+        if (error.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            config_ = json;
+            config_ready_ = true;
+            config_loaded = true;
+        } else {
+            std::cout << "Reload: keeping the current config, '" << config_path_ << "': " << error << std::endl;
+        }
+    }
+
+    // a generated mesh follows its config
+    if (generate_)
+        mesh = config_loaded;
+
+    if (mesh) {
+        auto start = std::chrono::steady_clock::now();
+        WarpMeshData data;
+        bool loaded = generate_ ? generator_->generate(json, optimize_, &data)
+                                : MeshLoader::load(mesh_path_, tex_path_, optimize_, &data);
+        if (!loaded) {
+            std::cout << "Reload: keeping the current mesh" << std::endl;
+            return;
+        }
+
+        std::cout << "Reload: built '" << (generate_ ? config_path_ : mesh_path_) << "' in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+        std::lock_guard<std::mutex> lock(mutex_);
+        mesh_ = std::move(data);
+        mesh_ready_ = true;
+    }
+}
@@ -0,0 +1,281 @@
+#include "../inc/pixel_format.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_FORMAT_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define PIXEL_FORMAT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// byte offsets of red, green and blue within a pixel
+void channelOffsets(PixelFormat::Format format, int *red, int *green, int *blue)
+{
+    bool rgb_order = format == PixelFormat::RGBA || format == PixelFormat::RGB;
+    *red = rgb_order ? 0 : 2;
+    *green = 1;
+    *blue = rgb_order ? 2 : 0;
+}
+
+void convertRowScalar(const unsigned char *src, PixelFormat::Format src_format, unsigned char *dst,
+                      PixelFormat::Format dst_format, int width)
+{
+    int src_red, src_green, src_blue;
+    int dst_red, dst_green, dst_blue;
+    channelOffsets(src_format, &src_red, &src_green, &src_blue);
+    channelOffsets(dst_format, &dst_red, &dst_green, &dst_blue);
+    int bytes = PixelFormat::bytesPerPixel(src_format);
+
+    for (int x = 0; x < width; ++x) {
+        dst[dst_red] = src[src_red];
+        dst[dst_green] = src[src_green];
+        dst[dst_blue] = src[src_blue];
+        dst[3] = 255;
+        src += bytes;
+        dst += 4;
+    }
+}
+
+// red and blue change places between source and destination
+bool swapsChannels(PixelFormat::Format src_format, PixelFormat::Format dst_format)
+{
+    return PixelFormat::directFormat(src_format) != dst_format;
+}
+
+#ifdef PIXEL_FORMAT_X86
+
+// byte shuffles from four source pixels to four destination pixels, alpha is set afterwards
+const int8_t SHUFFLE_COPY32[16] = {0, 1, 2, -1, 4, 5, 6, -1, 8, 9, 10, -1, 12, 13, 14, -1};
+const int8_t SHUFFLE_SWAP32[16] = {2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1};
+const int8_t SHUFFLE_EXPAND24[16] = {0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1};
+const int8_t SHUFFLE_SWAP24[16] = {2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1};
+
+const int8_t *shuffleMask(PixelFormat::Format src_format, PixelFormat::Format dst_format)
+{
+    bool swap = swapsChannels(src_format, dst_format);
+    if (PixelFormat::bytesPerPixel(src_format) == 4)
+        return swap ? SHUFFLE_SWAP32 : SHUFFLE_COPY32;
+    return swap ? SHUFFLE_SWAP24 : SHUFFLE_EXPAND24;
+}
+
+__attribute__((target("ssse3")))
+void convertRowSSSE3(const unsigned char *src, PixelFormat::Format src_format, unsigned char *dst,
+                     PixelFormat::Format dst_format, int width)
+{
+    const __m128i mask = _mm_loadu_si128((const __m128i *) shuffleMask(src_format, dst_format));
+    const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+    int bytes = PixelFormat::bytesPerPixel(src_format);
+
+    // a 24 bit step reads 16 bytes for 12 used ones, stop early enough to stay inside the row
+    int x = 0;
+    int end = bytes == 4 ? width - 4 : width - 6;
+    for (; x <= end; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + x * bytes));
+        _mm_storeu_si128((__m128i *) (dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha));
+    }
+    convertRowScalar(src + x * bytes, src_format, dst + x * 4, dst_format, width - x);
+}
+
+__attribute__((target("avx2")))
+void convertRowAVX2(const unsigned char *src, PixelFormat::Format src_format, unsigned char *dst,
+                    PixelFormat::Format dst_format, int width)
+{
+    const __m128i lane_mask = _mm_loadu_si128((const __m128i *) shuffleMask(src_format, dst_format));
+    const __m256i mask = _mm256_broadcastsi128_si256(lane_mask);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+    int bytes = PixelFormat::bytesPerPixel(src_format);
+
+    // vpshufb only shuffles within 128 bit lanes, so every lane gets four source pixels of its own
+    int x = 0;
+    int end = bytes == 4 ? width - 8 : width - 10;
+    for (; x <= end; x += 8) {
+        const unsigned char *pixels = src + x * bytes;
+        __m256i lanes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) pixels)),
+                                                _mm_loadu_si128((const __m128i *) (pixels + 4 * bytes)), 1);
+        _mm256_storeu_si256((__m256i *) (dst + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(lanes, mask), alpha));
+    }
+    convertRowScalar(src + x * bytes, src_format, dst + x * 4, dst_format, width - x);
+}
+
+bool hasSSSE3()
+{
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+bool hasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif
+
+#ifdef PIXEL_FORMAT_NEON
+
+void convertRowNEON(const unsigned char *src, PixelFormat::Format src_format, unsigned char *dst,
+                    PixelFormat::Format dst_format, int width)
+{
+    bool swap = swapsChannels(src_format, dst_format);
+    int bytes = PixelFormat::bytesPerPixel(src_format);
+    const uint8x16_t alpha = vdupq_n_u8(255);
+
+    // the structured loads split the channels, so all conversions only reorder registers
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t pixels;
+        if (bytes == 4) {
+            pixels = vld4q_u8(src + x * 4);
+        } else {
+            uint8x16x3_t packed = vld3q_u8(src + x * 3);
+            pixels.val[0] = packed.val[0];
+            pixels.val[1] = packed.val[1];
+            pixels.val[2] = packed.val[2];
+        }
+        if (swap) {
+            uint8x16_t first = pixels.val[0];
+            pixels.val[0] = pixels.val[2];
+            pixels.val[2] = first;
+        }
+        pixels.val[3] = alpha;
+        vst4q_u8(dst + x * 4, pixels);
+    }
+    convertRowScalar(src + x * bytes, src_format, dst + x * 4, dst_format, width - x);
+}
+
+#endif
+
+typedef void (*RowConverter)(const unsigned char *, PixelFormat::Format, unsigned char *, PixelFormat::Format, int);
+
+RowConverter rowConverter()
+{
+#if defined(PIXEL_FORMAT_X86)
+    if (hasAVX2())
+        return convertRowAVX2;
+    if (hasSSSE3())
+        return convertRowSSSE3;
+#elif defined(PIXEL_FORMAT_NEON)
+    return convertRowNEON;
+#endif
+    return convertRowScalar;
+}
+
+bool convertRows(RowConverter converter, const unsigned char *src, int src_stride, PixelFormat::Format src_format,
+                 unsigned char *dst, int dst_stride, PixelFormat::Format dst_format, int width, int height,
+                 bool flip)
+{
+    if (!PixelFormat::isDirect(dst_format) || PixelFormat::bytesPerPixel(src_format) == 0)
+        return false;
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *row = src + (size_t) src_stride * (flip ? height - 1 - y : y);
+        converter(row, src_format, dst + (size_t) dst_stride * y, dst_format, width);
+    }
+    return true;
+}
+
+}
+
+PixelFormat::Format PixelFormat::fromMasks(int bits_per_pixel, unsigned long red_mask, unsigned long green_mask,
+                                           unsigned long blue_mask, bool msb_first)
+{
+    if ((bits_per_pixel != 24 && bits_per_pixel != 32) || green_mask != 0xff00)
+        return UNKNOWN;
+
+    // masks describe the pixel value, the byte order decides where its low byte is stored
+    bool blue_low = blue_mask == 0xff && red_mask == 0xff0000;
+    bool red_low = red_mask == 0xff && blue_mask == 0xff0000;
+    if (!blue_low && !red_low)
+        return UNKNOWN;
+
+    bool blue_first;
+    if (bits_per_pixel == 24)
+        blue_first = blue_low != msb_first;
+    else if (!msb_first)
+        blue_first = blue_low;
+    else
+        // big endian 32 bit pixels keep the colour in the last three bytes, not supported
+        return UNKNOWN;
+
+    if (bits_per_pixel == 24)
+        return blue_first ? BGR : RGB;
+    return blue_first ? BGRA : RGBA;
+}
+
+int PixelFormat::bytesPerPixel(Format format)
+{
+    switch (format) {
+        case BGRA:
+        case RGBA:
+            return 4;
+        case BGR:
+        case RGB:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+bool PixelFormat::isDirect(Format format)
+{
+    return format == BGRA || format == RGBA;
+}
+
+PixelFormat::Format PixelFormat::directFormat(Format format)
+{
+    switch (format) {
+        case BGRA:
+        case BGR:
+            return BGRA;
+        case RGBA:
+        case RGB:
+            return RGBA;
+        default:
+            return UNKNOWN;
+    }
+}
+
+const char *PixelFormat::name(Format format)
+{
+    switch (format) {
+        case BGRA:
+            return "BGRA";
+        case RGBA:
+            return "RGBA";
+        case BGR:
+            return "BGR";
+        case RGB:
+            return "RGB";
+        default:
+            return "unknown";
+    }
+}
+
+bool PixelFormat::convert(const unsigned char *src, int src_stride, Format src_format, unsigned char *dst,
+                          int dst_stride, Format dst_format, int width, int height, bool flip)
+{
+    static const RowConverter converter = rowConverter();
+    return convertRows(converter, src, src_stride, src_format, dst, dst_stride, dst_format, width, height, flip);
+}
+
+const char *PixelFormat::kernelName()
+{
+#if defined(PIXEL_FORMAT_X86)
+    return hasAVX2() ? "AVX2" : hasSSSE3() ? "SSSE3" : "scalar";
+#elif defined(PIXEL_FORMAT_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+bool PixelFormat::convertScalar(const unsigned char *src, int src_stride, Format src_format, unsigned char *dst,
+                                int dst_stride, Format dst_format, int width, int height, bool flip)
+{
+    return convertRows(convertRowScalar, src, src_stride, src_format, dst, dst_stride, dst_format, width, height,
+                       flip);
+}
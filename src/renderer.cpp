@@ -0,0 +1,120 @@
+#include "../inc/renderer.h"
+#include "../inc/shader.h"
+
+#include <iostream>
+
+Renderer::Renderer()
+        : program_(0),
+          mvp_id_(-1),
+          sampler_id_(-1),
+          depth_(true),
+          mvp_(1.0f),
+          texture_(0),
+          program_dirty_(true),
+          mvp_dirty_(true),
+          texture_dirty_(true),
+          calls_(0)
+{
+}
+
+Renderer::~Renderer()
+{
+    release();
+}
+
+bool Renderer::init(const char *vertex_path, const char *fragment_path, bool depth)
+{
+    release();
+    depth_ = depth;
+
+    program_ = Shader::loadShaders(vertex_path, fragment_path);
+    if (!program_) {
+        std::cout << "Renderer: unable to load shaders" << std::endl;
+        return false;
+    }
+    mvp_id_ = glGetUniformLocation(program_, "MVP");
+    sampler_id_ = glGetUniformLocation(program_, "myTextureSampler");
+
+    if (depth_) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS); // Accept fragment if it closer to the camera than the former one
+    } else {
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    // the texture is always bound to unit 0, the sampler is set once
+    glUseProgram(program_);
+    glUniform1i(sampler_id_, 0);
+    invalidate();
+    return true;
+}
+
+void Renderer::release()
+{
+    if (program_)
+        glDeleteProgram(program_);
+    program_ = 0;
+    invalidate();
+}
+
+void Renderer::setView(const glm::mat4 &mvp)
+{
+    if (mvp == mvp_)
+        return;
+    mvp_ = mvp;
+    mvp_dirty_ = true;
+}
+
+void Renderer::setTexture(GLuint texture)
+{
+    if (texture == texture_)
+        return;
+    texture_ = texture;
+    texture_dirty_ = true;
+}
+
+void Renderer::invalidate()
+{
+    program_dirty_ = true;
+    mvp_dirty_ = true;
+    texture_dirty_ = true;
+}
+
+void Renderer::beginFrame(bool clear)
+{
+    calls_ = 0;
+    if (clear) {
+        glClear(depth_ ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT);
+        ++calls_;
+    }
+}
+
+void Renderer::draw(const WarpMesh &mesh, bool points)
+{
+    if (!program_)
+        return;
+
+    if (program_dirty_) {
+        glUseProgram(program_);
+        ++calls_;
+        program_dirty_ = false;
+    }
+    if (mvp_dirty_) {
+        glUniformMatrix4fv(mvp_id_, 1, GL_FALSE, &mvp_[0][0]);
+        ++calls_;
+        mvp_dirty_ = false;
+    }
+    if (texture_dirty_) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture_);
+        calls_ += 2;
+        texture_dirty_ = false;
+    }
+
+    calls_ += mesh.draw(points);
+}
+
+int Renderer::callCount() const
+{
+    return calls_;
+}
@@ -0,0 +1,203 @@
+#include "../inc/screen_capture.h"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <iostream>
+
+namespace {
+
+bool shm_attach_failed = false;
+
+int shmErrorHandler(Display *, XErrorEvent *)
+{
+    // XShmAttach fails with BadAccess on remote displays, which only shows up as an asynchronous X error
+    shm_attach_failed = true;
+    return 0;
+}
+
+}
+
+ScreenCapture::ScreenCapture(Display *display, Window window)
+        : display_(display),
+          window_(window),
+          image_(nullptr),
+          shm_info_(),
+          use_shm_(false),
+          x_(0),
+          y_(0),
+          width_(0),
+          height_(0)
+{
+}
+
+ScreenCapture::~ScreenCapture()
+{
+    close();
+}
+
+bool ScreenCapture::open(int x, int y, int width, int height, bool allow_shm)
+{
+    close();
+
+    x_ = x;
+    y_ = y;
+    width_ = width;
+    height_ = height;
+
+    if (allow_shm && openShm()) {
+        std::cout << "Capture: using MIT-SHM for " << width_ << "x" << height_ << " region" << std::endl;
+    } else {
+        // fallback: allocate the image once with XGetImage and refill it via XGetSubImage afterwards
+        image_ = XGetImage(display_, window_, x_, y_, (unsigned int) width_, (unsigned int) height_, AllPlanes,
+                           ZPixmap);
+        if (!image_) {
+            std::cout << "Capture: unable to grab " << width_ << "x" << height_ << " region" << std::endl;
+            return false;
+        }
+        std::cout << "Capture: MIT-SHM unavailable, falling back to XGetImage" << std::endl;
+    }
+
+    if (format() == PixelFormat::UNKNOWN) {
+        std::cout << "Capture: unsupported pixel layout with " << image_->bits_per_pixel << " bits per pixel"
+                  << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ScreenCapture::close()
+{
+    if (use_shm_) {
+        closeShm();
+    } else if (image_) {
+        XDestroyImage(image_);
+    }
+    image_ = nullptr;
+}
+
+XImage *ScreenCapture::grab()
+{
+    if (!image_)
+        return nullptr;
+
+    if (use_shm_) {
+        if (!XShmGetImage(display_, window_, image_, x_, y_, AllPlanes))
+            return nullptr;
+        return image_;
+    }
+
+    if (!XGetSubImage(display_, window_, x_, y_, (unsigned int) width_, (unsigned int) height_, AllPlanes, ZPixmap,
+                      image_, 0, 0))
+        return nullptr;
+    return image_;
+}
+
+XImage *ScreenCapture::grabRows(int y, int rows)
+{
+    if (!image_ || y < 0 || rows <= 0 || y + rows > height_)
+        return nullptr;
+
+    if (use_shm_) {
+        // a full width band of the image has the same row pitch, so the server can write it in place
+        XImage band = *image_;
+        band.height = rows;
+        band.data = image_->data + (size_t) image_->bytes_per_line * y;
+        if (!XShmGetImage(display_, window_, &band, x_, y_ + y, AllPlanes))
+            return nullptr;
+        return image_;
+    }
+
+    if (!XGetSubImage(display_, window_, x_, y_ + y, (unsigned int) width_, (unsigned int) rows, AllPlanes, ZPixmap,
+                      image_, 0, y))
+        return nullptr;
+    return image_;
+}
+
+bool ScreenCapture::usesSharedMemory() const
+{
+    return use_shm_;
+}
+
+PixelFormat::Format ScreenCapture::format() const
+{
+    if (!image_)
+        return PixelFormat::UNKNOWN;
+    return PixelFormat::fromMasks(image_->bits_per_pixel, image_->red_mask, image_->green_mask, image_->blue_mask,
+                                  image_->byte_order == MSBFirst);
+}
+
+int ScreenCapture::width() const
+{
+    return width_;
+}
+
+int ScreenCapture::height() const
+{
+    return height_;
+}
+
+bool ScreenCapture::openShm()
+{
+    if (!XShmQueryExtension(display_))
+        return false;
+
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display_, window_, &attributes))
+        return false;
+
+    image_ = XShmCreateImage(display_, attributes.visual, (unsigned int) attributes.depth, ZPixmap, nullptr,
+                             &shm_info_, (unsigned int) width_, (unsigned int) height_);
+    if (!image_)
+        return false;
+
+    shm_info_.shmid = shmget(IPC_PRIVATE, (size_t) image_->bytes_per_line * image_->height, IPC_CREAT | 0600);
+    if (shm_info_.shmid < 0) {
+        XDestroyImage(image_);
+        image_ = nullptr;
+        return false;
+    }
+
+    shm_info_.shmaddr = image_->data = (char *) shmat(shm_info_.shmid, nullptr, 0);
+    shm_info_.readOnly = False;
+    if (shm_info_.shmaddr == (char *) -1) {
+        shmctl(shm_info_.shmid, IPC_RMID, nullptr);
+        image_->data = nullptr;
+        XDestroyImage(image_);
+        image_ = nullptr;
+        return false;
+    }
+
+    shm_attach_failed = false;
+    XErrorHandler previous_handler = XSetErrorHandler(shmErrorHandler);
+    XShmAttach(display_, &shm_info_);
+    XSync(display_, False);
+    XSetErrorHandler(previous_handler);
+
+    // mark for removal now, the segment stays alive until both sides detached
+    shmctl(shm_info_.shmid, IPC_RMID, nullptr);
+
+    if (shm_attach_failed) {
+        shmdt(shm_info_.shmaddr);
+        image_->data = nullptr;
+        XDestroyImage(image_);
+        image_ = nullptr;
+        return false;
+    }
+
+    use_shm_ = true;
+    return true;
+}
+
+void ScreenCapture::closeShm()
+{
+    XShmDetach(display_, &shm_info_);
+    XSync(display_, False);
+
+    // the pixel data belongs to the segment, XDestroyImage must not free it
+    image_->data = nullptr;
+    XDestroyImage(image_);
+    shmdt(shm_info_.shmaddr);
+
+    use_shm_ = false;
+}
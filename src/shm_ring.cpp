@@ -0,0 +1,165 @@
+#include "../inc/shm_ring.h"
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char ShmRingProducer::MAGIC[4] = {'G', 'L', 'W', 'R'};
+
+static_assert(sizeof(ShmRingHeader::slots) / sizeof(ShmRingSlot) == ShmRingProducer::MAX_SLOTS,
+              "slot array and MAX_SLOTS differ");
+
+namespace {
+
+size_t pageAligned(size_t size)
+{
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+void wakeConsumers(ShmRingHeader *header)
+{
+    syscall(SYS_futex, &header->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+}
+
+ShmRingProducer::ShmRingProducer()
+        : name_(),
+          header_(nullptr),
+          mapping_size_(0),
+          write_slot_(0),
+          frame_count_(0)
+{
+}
+
+ShmRingProducer::~ShmRingProducer()
+{
+    close();
+}
+
+bool ShmRingProducer::create(const std::string &name, int width, int height, PixelFormat::Format format, int slots)
+{
+    close();
+
+    int bytes_per_pixel = PixelFormat::bytesPerPixel(format);
+    if (width <= 0 || height <= 0 || bytes_per_pixel == 0 || slots < 2 || slots > MAX_SLOTS) {
+        std::cout << "Ring: unsupported ring of " << slots << " slots of " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    // a consumer still attached to an old object keeps it until it detaches
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        std::cout << "Ring: unable to create shared memory '" << name << "'" << std::endl;
+        return false;
+    }
+
+    uint32_t stride = (uint32_t) width * (uint32_t) bytes_per_pixel;
+    size_t slot_offset = pageAligned(sizeof(ShmRingHeader));
+    size_t slot_size = pageAligned((size_t) stride * height);
+    size_t size = slot_offset + slot_size * slots;
+    void *mapping = MAP_FAILED;
+    if (slot_size <= UINT32_MAX && ftruncate(fd, (off_t) size) == 0)
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cout << "Ring: unable to map " << size << " bytes of shared memory '" << name << "'" << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    name_ = name;
+    mapping_size_ = size;
+    header_ = (ShmRingHeader *) mapping;
+
+    // a new object is zero filled, everything but the geometry and the empty reading slot is already in place
+    header_->version = VERSION;
+    header_->width = (uint32_t) width;
+    header_->height = (uint32_t) height;
+    header_->stride = stride;
+    header_->format = (uint32_t) format;
+    header_->slot_count = (uint32_t) slots;
+    header_->slot_size = (uint32_t) slot_size;
+    header_->slot_offset = (uint32_t) slot_offset;
+    header_->reading.store(NO_SLOT);
+
+    // consumers check the magic first, it is written last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, MAGIC, sizeof(MAGIC));
+
+    write_slot_ = 0;
+    frame_count_ = 0;
+    std::cout << "Ring: publishing " << width << "x" << height << " " << PixelFormat::name(format) << " frames in "
+              << slots << " slots of '" << name_ << "'" << std::endl;
+    return true;
+}
+
+void ShmRingProducer::close()
+{
+    if (header_) {
+        header_->closed.store(1);
+        header_->sequence.fetch_add(2, std::memory_order_release);
+        wakeConsumers(header_);
+        munmap(header_, mapping_size_);
+        shm_unlink(name_.c_str());
+        header_ = nullptr;
+    }
+    mapping_size_ = 0;
+}
+
+int ShmRingProducer::stride() const
+{
+    return header_ ? (int) header_->stride : 0;
+}
+
+unsigned char *ShmRingProducer::beginFrame()
+{
+    if (!header_)
+        return nullptr;
+
+    // the next slot that is neither the latest frame nor held by the consumer. With two slots the consumer may
+    // hold the only one that is not the latest, its frame then turns out torn.
+    uint32_t count = header_->slot_count;
+    uint32_t latest = frame_count_ > 0 ? header_->latest_slot.load(std::memory_order_relaxed) : NO_SLOT;
+    uint32_t reading = header_->reading.load();
+    uint32_t slot = NO_SLOT;
+    for (int pass = 0; pass < 2 && slot == NO_SLOT; ++pass) {
+        for (uint32_t i = 1; i <= count && slot == NO_SLOT; ++i) {
+            uint32_t candidate = (write_slot_ + i) % count;
+            if (candidate != latest && (pass == 1 || candidate != reading))
+                slot = candidate;
+        }
+    }
+    write_slot_ = slot;
+
+    header_->slots[slot].sequence.store(2 * (frame_count_ + 1) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return (unsigned char *) header_ + header_->slot_offset + (size_t) header_->slot_size * slot;
+}
+
+void ShmRingProducer::publish(uint64_t timestamp)
+{
+    if (!header_)
+        return;
+
+    ++frame_count_;
+    header_->slots[write_slot_].sequence.store(2 * frame_count_, std::memory_order_release);
+
+    uint32_t sequence = header_->sequence.load(std::memory_order_relaxed);
+    header_->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->latest_slot.store(write_slot_, std::memory_order_relaxed);
+    header_->latest_frame.store(frame_count_, std::memory_order_relaxed);
+    header_->latest_timestamp.store(timestamp, std::memory_order_relaxed);
+    header_->sequence.store(sequence + 2, std::memory_order_release);
+
+    wakeConsumers(header_);
+}
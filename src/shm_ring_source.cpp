@@ -0,0 +1,269 @@
+#include "../inc/shm_ring_source.h"
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// the producer holds the header seqlock for three stores, a reader that keeps colliding gives up until the next wait
+const int SEQLOCK_ATTEMPTS = 100;
+
+}
+
+const int ShmRingSource::REOPEN_INTERVAL_MS;
+
+ShmRingSource::ShmRingSource(const FrameSourceSettings &settings)
+        : settings_(settings),
+          header_(nullptr),
+          mapping_size_(0),
+          seen_sequence_(0),
+          last_frame_(0),
+          acquired_slot_(ShmRingProducer::NO_SLOT),
+          acquired_sequence_(0),
+          skipped_(0),
+          torn_(0),
+          closed_reported_(false),
+          next_reopen_()
+{
+}
+
+ShmRingSource::~ShmRingSource()
+{
+    close();
+}
+
+bool ShmRingSource::open()
+{
+    close();
+
+    size_t size;
+    ShmRingHeader *header = map(true, &size);
+    if (!header)
+        return false;
+    attach(header, size);
+    return true;
+}
+
+ShmRingHeader *ShmRingSource::map(bool report, size_t *size) const
+{
+    // the consumer writes the slot it reads, so the ring is mapped writable
+    int fd = shm_open(settings_.path.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        if (report)
+            std::cout << "Source: unable to open shared memory ring '" << settings_.path << "'" << std::endl;
+        return nullptr;
+    }
+
+    struct stat ring_stat;
+    if (fstat(fd, &ring_stat) != 0 || (size_t) ring_stat.st_size < sizeof(ShmRingHeader)) {
+        if (report)
+            std::cout << "Source: '" << settings_.path << "' is not a frame ring" << std::endl;
+        ::close(fd);
+        return nullptr;
+    }
+
+    *size = (size_t) ring_stat.st_size;
+    void *mapping = mmap(nullptr, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        if (report)
+            std::cout << "Source: unable to map frame ring '" << settings_.path << "'" << std::endl;
+        return nullptr;
+    }
+    auto header = (ShmRingHeader *) mapping;
+
+    // the geometry is complete once the magic is there
+    bool valid = std::memcmp(header->magic, ShmRingProducer::MAGIC, 4) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    int bytes_per_pixel = PixelFormat::bytesPerPixel((PixelFormat::Format) header->format);
+    size_t frame_size = (size_t) header->stride * header->height;
+    valid = valid && header->version == ShmRingProducer::VERSION && bytes_per_pixel > 0 &&
+            header->stride >= header->width * (uint32_t) bytes_per_pixel && header->slot_count >= 2 &&
+            header->slot_count <= (uint32_t) ShmRingProducer::MAX_SLOTS && header->slot_size >= frame_size &&
+            header->slot_offset >= sizeof(ShmRingHeader) &&
+            header->slot_offset + (size_t) header->slot_size * header->slot_count <= *size;
+    if (!valid) {
+        if (report)
+            std::cout << "Source: '" << settings_.path << "' is not a frame ring" << std::endl;
+        munmap(mapping, *size);
+        return nullptr;
+    }
+    return header;
+}
+
+void ShmRingSource::attach(ShmRingHeader *header, size_t size)
+{
+    header_ = header;
+    mapping_size_ = size;
+    seen_sequence_ = header_->sequence.load();
+    last_frame_ = 0;
+    acquired_slot_ = ShmRingProducer::NO_SLOT;
+    skipped_ = 0;
+    torn_ = 0;
+    closed_reported_ = false;
+    std::cout << "Source: taking " << header_->width << "x" << header_->height << " "
+              << PixelFormat::name(format()) << " frames from " << header_->slot_count << " slots of '"
+              << settings_.path << "'" << std::endl;
+}
+
+void ShmRingSource::close()
+{
+    if (header_) {
+        release();
+        if (last_frame_ > 0) {
+            std::cout << "Source: " << skipped_ << " frames of '" << settings_.path << "' skipped, " << torn_
+                      << " torn" << std::endl;
+        }
+        munmap(header_, mapping_size_);
+        header_ = nullptr;
+    }
+    mapping_size_ = 0;
+}
+
+void ShmRingSource::release()
+{
+    if (acquired_slot_ == ShmRingProducer::NO_SLOT)
+        return;
+    header_->reading.store(ShmRingProducer::NO_SLOT);
+    acquired_slot_ = ShmRingProducer::NO_SLOT;
+}
+
+void ShmRingSource::waitForFrame(double timeout_seconds)
+{
+    if (!header_) {
+        FrameSource::waitForFrame(timeout_seconds);
+        return;
+    }
+
+    // returns right away if a frame was published since the header was read
+    struct timespec timeout;
+    timeout.tv_sec = (time_t) timeout_seconds;
+    timeout.tv_nsec = (long) ((timeout_seconds - (double) timeout.tv_sec) * 1e9);
+    syscall(SYS_futex, &header_->sequence, FUTEX_WAIT, seen_sequence_, &timeout, nullptr, 0);
+}
+
+bool ShmRingSource::frameIntact()
+{
+    if (acquired_slot_ == ShmRingProducer::NO_SLOT)
+        return true;
+
+    // the pixels were read before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->slots[acquired_slot_].sequence.load(std::memory_order_relaxed) == acquired_sequence_)
+        return true;
+    ++torn_;
+    return false;
+}
+
+bool ShmRingSource::framesInPlace() const
+{
+    // with two slots the producer may have to write the one being read
+    return header_ && header_->slot_count >= 3;
+}
+
+const char *ShmRingSource::name() const
+{
+    return "ring";
+}
+
+int ShmRingSource::width() const
+{
+    return header_ ? (int) header_->width : 0;
+}
+
+int ShmRingSource::height() const
+{
+    return header_ ? (int) header_->height : 0;
+}
+
+PixelFormat::Format ShmRingSource::format() const
+{
+    return header_ ? (PixelFormat::Format) header_->format : PixelFormat::BGRA;
+}
+
+FrameSource::Result ShmRingSource::acquireFrame(SourceFrame *frame)
+{
+    if (!header_)
+        return FAILED;
+
+    if (header_->closed.load()) {
+        // waits sleep the full timeout from now on
+        seen_sequence_ = header_->sequence.load();
+        if (!closed_reported_) {
+            std::cout << "Source: the producer of '" << settings_.path << "' closed the ring, waiting for a new one"
+                      << std::endl;
+        }
+        closed_reported_ = true;
+
+        // a restarted producer creates a new ring under the same name, the closed one may still be there briefly
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_reopen_)
+            return UNCHANGED;
+        next_reopen_ = now + std::chrono::milliseconds(REOPEN_INTERVAL_MS);
+        size_t size;
+        ShmRingHeader *header = map(false, &size);
+        if (header && header->closed.load()) {
+            munmap(header, size);
+            header = nullptr;
+        }
+        if (header) {
+            close();
+            attach(header, size);
+        }
+        return UNCHANGED;
+    }
+
+    uint32_t slot;
+    uint64_t latest;
+    if (!readLatest(&slot, &latest) || latest == last_frame_)
+        return UNCHANGED;
+
+    // announce the slot, then make sure the producer did not start on it before it could see that. If it did,
+    // a newer frame is published already and taken next.
+    header_->reading.store(slot);
+    uint64_t sequence = header_->slots[slot].sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * latest) {
+        header_->reading.store(ShmRingProducer::NO_SLOT);
+        return UNCHANGED;
+    }
+
+    if (last_frame_ > 0 && latest > last_frame_ + 1)
+        skipped_ += (unsigned long) (latest - last_frame_ - 1);
+    last_frame_ = latest;
+    acquired_slot_ = slot;
+    acquired_sequence_ = sequence;
+
+    frame->pixels = (const unsigned char *) header_ + header_->slot_offset + (size_t) header_->slot_size * slot;
+    frame->width = (int) header_->width;
+    frame->height = (int) header_->height;
+    frame->stride = (int) header_->stride;
+    frame->format = format();
+    frame->full = true;
+    frame->dirty.clear();
+    return ACQUIRED;
+}
+
+bool ShmRingSource::readLatest(uint32_t *slot, uint64_t *frame)
+{
+    for (int attempt = 0; attempt < SEQLOCK_ATTEMPTS; ++attempt) {
+        uint32_t before = header_->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        *slot = header_->latest_slot.load(std::memory_order_relaxed);
+        *frame = header_->latest_frame.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->sequence.load(std::memory_order_relaxed) == before) {
+            seen_sequence_ = before;
+            return *frame > 0 && *slot < header_->slot_count;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,154 @@
+#include "../inc/synthetic_source.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// BGRA colour bars
+const unsigned char BAR_COLORS[8][4] = {
+        {255, 255, 255, 255},
+        {0,   255, 255, 255},
+        {255, 255, 0,   255},
+        {0,   255, 0,   255},
+        {255, 0,   255, 255},
+        {0,   0,   255, 255},
+        {255, 0,   0,   255},
+        {0,   0,   0,   255}
+};
+
+}
+
+const int SyntheticSource::BOX_SIZE;
+const int SyntheticSource::COUNTER_BITS;
+
+SyntheticSource::SyntheticSource(const FrameSourceSettings &settings)
+        : width_(settings.width > 0 ? settings.width : 1024),
+          height_(settings.height > 0 ? settings.height : 1024),
+          pixels_(),
+          frame_index_(0)
+{
+}
+
+bool SyntheticSource::open()
+{
+    pixels_.assign((size_t) width_ * height_ * 4, 0);
+    frame_index_ = 0;
+
+    Rect frame = {0, 0, width_, height_};
+    drawBars(frame);
+
+    std::cout << "Source: synthetic " << width_ << "x" << height_ << " test pattern" << std::endl;
+    return true;
+}
+
+void SyntheticSource::close()
+{
+    pixels_.clear();
+}
+
+const char *SyntheticSource::name() const
+{
+    return "synthetic";
+}
+
+int SyntheticSource::width() const
+{
+    return width_;
+}
+
+int SyntheticSource::height() const
+{
+    return height_;
+}
+
+FrameSource::Result SyntheticSource::acquireFrame(SourceFrame *frame)
+{
+    if (pixels_.empty())
+        return FAILED;
+
+    frame->dirty.clear();
+    frame->full = frame_index_ == 0;
+
+    // restore the bars below the previous box, then draw the box at its new position
+    Rect previous = boxRect(frame_index_ == 0 ? 0 : frame_index_ - 1);
+    Rect current = boxRect(frame_index_);
+    drawBars(previous);
+    drawBox(current.x, current.y);
+    drawCounter();
+
+    if (!frame->full) {
+        frame->dirty.push_back(previous);
+        frame->dirty.push_back(current);
+        frame->dirty.push_back(counterRect());
+    }
+
+    frame->pixels = pixels_.data();
+    frame->width = width_;
+    frame->height = height_;
+    frame->stride = width_ * 4;
+    frame->format = PixelFormat::BGRA;
+
+    ++frame_index_;
+    return ACQUIRED;
+}
+
+void SyntheticSource::drawBars(const Rect &rect)
+{
+    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+        unsigned char *pixel = pixels_.data() + ((size_t) y * width_ + rect.x) * 4;
+        for (int x = rect.x; x < rect.x + rect.width; ++x) {
+            const unsigned char *color = BAR_COLORS[(x * 8) / width_];
+            std::copy(color, color + 4, pixel);
+            pixel += 4;
+        }
+    }
+}
+
+void SyntheticSource::drawBox(int x, int y)
+{
+    int size = std::min(BOX_SIZE, std::min(width_, height_));
+    for (int row = y; row < y + size; ++row) {
+        unsigned char *pixel = pixels_.data() + ((size_t) row * width_ + x) * 4;
+        std::fill(pixel, pixel + size * 4, (unsigned char) 128);
+    }
+}
+
+Rect SyntheticSource::counterRect() const
+{
+    int block = std::max(width_ / COUNTER_BITS, 1);
+    Rect rect = {0, 0, std::min(block * COUNTER_BITS, width_), std::min(block, height_)};
+    return rect;
+}
+
+void SyntheticSource::drawCounter()
+{
+    Rect rect = counterRect();
+    int block = rect.height;
+    for (int y = 0; y < rect.height; ++y) {
+        unsigned char *pixel = pixels_.data() + (size_t) y * width_ * 4;
+        for (int x = 0; x < rect.width; ++x) {
+            unsigned char value = ((frame_index_ >> (x / block)) & 1) ? 255 : 0;
+            pixel[0] = pixel[1] = pixel[2] = value;
+            pixel[3] = 255;
+            pixel += 4;
+        }
+    }
+}
+
+Rect SyntheticSource::boxRect(unsigned long index) const
+{
+    // the box bounces between the left and right edge along a diagonal
+    int size = std::min(BOX_SIZE, std::min(width_, height_));
+    int range_x = std::max(width_ - size, 1);
+    int range_y = std::max(height_ - size, 1);
+    int step_x = (int) ((index * 4) % (unsigned long) (2 * range_x));
+    int step_y = (int) ((index * 3) % (unsigned long) (2 * range_y));
+
+    Rect rect = {step_x < range_x ? step_x : 2 * range_x - step_x,
+                 step_y < range_y ? step_y : 2 * range_y - step_y,
+                 size, size};
+    rect.x = std::min(rect.x, width_ - size);
+    rect.y = std::min(rect.y, height_ - size);
+    return rect;
+}
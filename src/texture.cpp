@@ -1,6 +1,9 @@
 #include "../inc/texture.h"
+#include "../inc/pixel_format.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <vector>
 
 GLuint Texture::loadBMP(const char *imagepath)
 {
@@ -11,7 +14,9 @@ GLuint Texture::loadBMP(const char *imagepath)
     unsigned char header[54];
     unsigned int dataPos;
     unsigned int imageSize;
-    unsigned int width, height;
+    int width, height;
+    bool bottomUp;
+    unsigned int rowSize;
     // Actual RGB data
     unsigned char *data;
 
@@ -55,15 +60,28 @@ GLuint Texture::loadBMP(const char *imagepath)
     width = *(int *) &(header[0x12]);
     height = *(int *) &(header[0x16]);
 
+    // A negative height marks the rare top-down BMP, the rows are usually stored bottom-up
+    bottomUp = height > 0;
+    height = abs(height);
+
+    // Every row is padded to 4 bytes
+    rowSize = ((unsigned int) width * 3 + 3) & ~3u;
+
     // Some BMP files are misformatted, guess missing information
-    if (imageSize == 0) imageSize = width * height * 3; // 3 : one byte for each Red, Green and Blue component
+    if (imageSize < rowSize * height) imageSize = rowSize * height; // 3 bytes per pixel, rows padded
     if (dataPos == 0) dataPos = 54; // The BMP header is done that way
 
     // Create a buffer
     data = new unsigned char[imageSize];
 
     // Read the actual data from the file into the buffer
-    fread(data, 1, imageSize, file);
+    fseek(file, dataPos, SEEK_SET);
+    if (fread(data, 1, imageSize, file) < rowSize * height) {
+        printf("Not a correct BMP file\n");
+        delete[] data;
+        fclose(file);
+        return 0;
+    }
 
     // Everything is in memory now, the file can be closed.
     fclose(file);
@@ -75,12 +93,15 @@ GLuint Texture::loadBMP(const char *imagepath)
     // "Bind" the newly created texture : all future texture functions will modify this texture
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    // Give the image to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-    // OpenGL has now copied the data. Free our own version
+    // Convert to top-down RGBA like the captured frames, the shader expects the image origin in the upper left
+    std::vector<unsigned char> pixels((size_t) width * height * 4);
+    PixelFormat::convert(data, (int) rowSize, PixelFormat::BGR, pixels.data(), width * 4, PixelFormat::RGBA, width,
+                         height, bottomUp);
     delete[] data;
 
+    // Give the image to OpenGL
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
     // Poor filtering, or ...
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
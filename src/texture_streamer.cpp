@@ -0,0 +1,232 @@
+#include "../inc/texture_streamer.h"
+
+#include <cstring>
+#include <iostream>
+
+TextureStreamer::TextureStreamer()
+        : texture_(0),
+          width_(0),
+          height_(0),
+          mode_(PBO),
+          upload_format_(GL_BGRA),
+          upload_type_(GL_UNSIGNED_INT_8_8_8_8_REV),
+          buffers_(),
+          fences_(),
+          mapped_(),
+          buffer_size_(0),
+          persistent_(false),
+          next_buffer_(0),
+          full_region_(),
+          map_failed_reported_(false)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    release();
+}
+
+bool TextureStreamer::init(int width, int height, Mode mode, int buffer_count)
+{
+    release();
+
+    width_ = width;
+    height_ = height;
+    mode_ = mode;
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (mode_ == SYNC) {
+        std::cout << "Upload: synchronous glTexSubImage2D" << std::endl;
+        return true;
+    }
+
+    buffer_size_ = (size_t) width_ * height_ * 4;
+    persistent_ = GLEW_ARB_buffer_storage != 0;
+
+    buffers_.resize((size_t) buffer_count);
+    fences_.assign((size_t) buffer_count, nullptr);
+    mapped_.assign((size_t) buffer_count, nullptr);
+    glGenBuffers(buffer_count, buffers_.data());
+
+    for (int i = 0; i < buffer_count; ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[i]);
+        if (persistent_) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, buffer_size_, nullptr, flags);
+            mapped_[i] = (unsigned char *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffer_size_, flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size_, nullptr, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    std::cout << "Upload: " << buffer_count << " pixel buffers, "
+              << (persistent_ ? "persistently mapped" : "orphaned per frame") << std::endl;
+    return true;
+}
+
+void TextureStreamer::release()
+{
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        if (fences_[i])
+            glDeleteSync(fences_[i]);
+        if (mapped_[i]) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[i]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!buffers_.empty())
+        glDeleteBuffers((GLsizei) buffers_.size(), buffers_.data());
+    buffers_.clear();
+    fences_.clear();
+    mapped_.clear();
+    next_buffer_ = 0;
+
+    if (texture_) {
+        glDeleteTextures(1, &texture_);
+        texture_ = 0;
+    }
+}
+
+void TextureStreamer::upload(const unsigned char *pixels, int width, int height, int stride,
+                             PixelFormat::Format format, const std::vector<Rect> *regions)
+{
+    if (!PixelFormat::isDirect(format)) {
+        std::cout << "Upload: " << PixelFormat::name(format) << " frames have to be converted first" << std::endl;
+        return;
+    }
+
+    if (width > width_ || height > height_) {
+        std::cout << "Upload: frame " << width << "x" << height << " exceeds texture size" << std::endl;
+        return;
+    }
+
+    if (!regions) {
+        Rect frame = {0, 0, width, height};
+        full_region_.assign(1, frame);
+        regions = &full_region_;
+    }
+
+    setUploadFormat(format);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    if (mode_ == SYNC)
+        uploadSync(pixels, stride, *regions);
+    else
+        uploadPBO(pixels, stride, *regions);
+}
+
+GLuint TextureStreamer::texture() const
+{
+    return texture_;
+}
+
+int TextureStreamer::width() const
+{
+    return width_;
+}
+
+int TextureStreamer::height() const
+{
+    return height_;
+}
+
+bool TextureStreamer::isPersistent() const
+{
+    return persistent_;
+}
+
+void TextureStreamer::uploadSync(const unsigned char *pixels, int stride, const std::vector<Rect> &regions)
+{
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / 4);
+    for (const Rect &rect : regions) {
+        const unsigned char *source = pixels + (size_t) stride * rect.y + (size_t) rect.x * 4;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, upload_format_, upload_type_,
+                        source);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void TextureStreamer::uploadPBO(const unsigned char *pixels, int stride, const std::vector<Rect> &regions)
+{
+    int index = next_buffer_;
+    next_buffer_ = (next_buffer_ + 1) % (int) buffers_.size();
+
+    waitForBuffer(index);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[index]);
+
+    unsigned char *target = mapped_[index];
+    if (!persistent_) {
+        // orphan the old storage so the driver never has to wait for a pending transfer
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size_, nullptr, GL_STREAM_DRAW);
+        target = (unsigned char *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffer_size_,
+                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                                    GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    // the orphaned buffer is undefined, this frame is uploaded from client memory instead
+    if (!target) {
+        if (!map_failed_reported_)
+            std::cout << "Upload: unable to map pixel buffer, uploading without it" << std::endl;
+        map_failed_reported_ = true;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        uploadSync(pixels, stride, regions);
+        return;
+    }
+
+    // regions keep their position in the buffer, which is laid out like a tightly packed texture
+    size_t texture_stride = (size_t) width_ * 4;
+    for (const Rect &rect : regions) {
+        size_t row_size = (size_t) rect.width * 4;
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+            std::memcpy(target + texture_stride * y + (size_t) rect.x * 4,
+                        pixels + (size_t) stride * y + (size_t) rect.x * 4, row_size);
+    }
+
+    if (!persistent_)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // the texture updates are sourced from the bound buffer
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width_);
+    for (const Rect &rect : regions) {
+        size_t offset = texture_stride * rect.y + (size_t) rect.x * 4;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, upload_format_, upload_type_,
+                        (void *) offset);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    fences_[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::setUploadFormat(PixelFormat::Format format)
+{
+    // BGRA as packed 8_8_8_8_REV matches the native texture layout of most drivers and avoids a conversion
+    if (format == PixelFormat::BGRA) {
+        upload_format_ = GL_BGRA;
+        upload_type_ = GL_UNSIGNED_INT_8_8_8_8_REV;
+    } else {
+        upload_format_ = GL_RGBA;
+        upload_type_ = GL_UNSIGNED_BYTE;
+    }
+}
+
+void TextureStreamer::waitForBuffer(int index)
+{
+    if (!fences_[index])
+        return;
+
+    // with three buffers this fence is two frames old and practically always signaled
+    GLenum result = glClientWaitSync(fences_[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fences_[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+    glDeleteSync(fences_[index]);
+    fences_[index] = nullptr;
+}
@@ -0,0 +1,87 @@
+#include "../inc/thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads)
+        : workers_(),
+          mutex_(),
+          start_(),
+          done_(),
+          task_(nullptr),
+          count_(0),
+          next_(0),
+          active_(0),
+          generation_(0),
+          stopping_(false)
+{
+    if (threads <= 0)
+        threads = (int) std::max(std::thread::hardware_concurrency(), 1u);
+
+    // the calling thread is the first worker
+    for (int i = 1; i < threads; ++i)
+        workers_.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (std::thread &worker : workers_)
+        worker.join();
+}
+
+int ThreadPool::threadCount() const
+{
+    return (int) workers_.size() + 1;
+}
+
+void ThreadPool::run(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        active_ = (int) workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    runTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return active_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::work()
+{
+    unsigned long generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&]() { return stopping_ || generation_ != generation; });
+            if (stopping_)
+                return;
+            generation = generation_;
+        }
+
+        runTasks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0)
+            done_.notify_one();
+    }
+}
+
+void ThreadPool::runTasks()
+{
+    for (int i = next_++; i < count_; i = next_++)
+        (*task_)(i);
+}
@@ -0,0 +1,35 @@
+#include "../inc/view_transform.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+glm::mat4 ViewTransform::mvp(const glm::vec3 &model_position, const glm::vec3 &model_rotation)
+{
+    // projection matrix
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    // camera matrix
+    glm::mat4 view = glm::lookAt(
+            glm::vec3(0.0, 0.0, 0.0), // camera pos world space
+            glm::vec3(0.0, 0.0, 100.0), // camera lookat
+            glm::vec3(0, 1, 0)  // up-vec
+    );
+
+    // model
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, model_position);
+    model = glm::translate(model, glm::vec3(-model_position));
+    model = glm::rotate(model, model_rotation.x, glm::vec3(1, 0, 0));
+    model = glm::translate(model, glm::vec3(model_position));
+
+    // build mvp
+    return projection * view * model;
+}
+
+glm::vec3 ViewTransform::modelPosition(const json11::Json &config)
+{
+    float projector_x = (float) config["projector"]["position"]["x"].number_value();
+    float projector_y = (float) config["projector"]["position"]["y"].number_value();
+    float projector_z = (float) config["projector"]["position"]["z"].number_value();
+
+    return glm::vec3(-1 * projector_x, -1 * projector_y, -1 * projector_z);
+}
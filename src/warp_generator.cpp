@@ -0,0 +1,406 @@
+#include "../inc/warp_generator.h"
+#include "../inc/mesh_builder.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// distance of the generated texture coordinates to their targets
+const double TOLERANCE = 1e-7;
+const int MAX_ITERATIONS = 20;
+// step of the numeric derivative, in tangent units of the projector image
+const double DERIVATIVE_STEP = 1e-6;
+// buckets per axis of the dome base that collect the nearest grid ray for the initial guesses
+const int BUCKETS = 64;
+
+const double PI = 3.14159265358979323846;
+
+template<typename T>
+struct Setup {
+    T rotation[9];
+    T projector[3];
+    T mirror[3];
+    T mirror_radius;
+    T dome[3];
+    T dome_radius;
+};
+
+template<typename T>
+Setup<T> makeSetup(const WarpGeometry &geometry)
+{
+    glm::mat4 rotation(1.0f);
+    rotation = glm::rotate(rotation, glm::radians(geometry.projector_rotation.x), glm::vec3(1, 0, 0));
+    rotation = glm::rotate(rotation, glm::radians(geometry.projector_rotation.y), glm::vec3(0, 1, 0));
+    rotation = glm::rotate(rotation, glm::radians(geometry.projector_rotation.z), glm::vec3(0, 0, 1));
+
+    Setup<T> setup;
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 3; ++column)
+            setup.rotation[row * 3 + column] = (T) rotation[column][row];
+        setup.projector[row] = (T) geometry.projector_position[row];
+        setup.mirror[row] = (T) geometry.mirror_position[row];
+        setup.dome[row] = (T) geometry.dome_position[row];
+    }
+    setup.mirror_radius = (T) geometry.mirror_radius;
+    setup.dome_radius = (T) geometry.dome_radius;
+    return setup;
+}
+
+// Traces the rays through the projector image tangents (tx, ty) off the mirror onto the dome and returns the
+// dome base coordinates (qx, qz) of the hits, NaN for rays that miss. Without branches, so the compiler can
+// vectorise the loop for floats.
+template<typename T>
+void trace(const Setup<T> &setup, const T *tx, const T *ty, int count, bool upper_only, T *qx, T *qz)
+{
+    const T *r = setup.rotation;
+    const T nan = std::numeric_limits<T>::quiet_NaN();
+    T oc[3] = {setup.projector[0] - setup.mirror[0], setup.projector[1] - setup.mirror[1],
+               setup.projector[2] - setup.mirror[2]};
+    T oc_c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - setup.mirror_radius * setup.mirror_radius;
+    T inverse_mirror_radius = 1 / setup.mirror_radius;
+    T inverse_dome_radius = 1 / setup.dome_radius;
+    T min_height = upper_only ? 0 : -2;
+
+    for (int i = 0; i < count; ++i) {
+        // the projector looks along -z
+        T dx = r[0] * tx[i] + r[1] * ty[i] - r[2];
+        T dy = r[3] * tx[i] + r[4] * ty[i] - r[5];
+        T dz = r[6] * tx[i] + r[7] * ty[i] - r[8];
+        T inverse_length = 1 / std::sqrt(dx * dx + dy * dy + dz * dz);
+        dx *= inverse_length;
+        dy *= inverse_length;
+        dz *= inverse_length;
+
+        // near side of the mirror sphere
+        T b = oc[0] * dx + oc[1] * dy + oc[2] * dz;
+        T h = b * b - oc_c;
+        T t = -b - std::sqrt(std::max(h, (T) 0));
+        bool hit = h >= 0 && t > 0;
+
+        T px = setup.projector[0] + t * dx;
+        T py = setup.projector[1] + t * dy;
+        T pz = setup.projector[2] + t * dz;
+        T nx = (px - setup.mirror[0]) * inverse_mirror_radius;
+        T ny = (py - setup.mirror[1]) * inverse_mirror_radius;
+        T nz = (pz - setup.mirror[2]) * inverse_mirror_radius;
+        T d_n = 2 * (dx * nx + dy * ny + dz * nz);
+        T rx = dx - d_n * nx;
+        T ry = dy - d_n * ny;
+        T rz = dz - d_n * nz;
+
+        // the dome is seen from below, so the reflected ray ends on the far side of its sphere
+        T ox = px - setup.dome[0];
+        T oy = py - setup.dome[1];
+        T oz = pz - setup.dome[2];
+        T b2 = ox * rx + oy * ry + oz * rz;
+        T h2 = b2 * b2 - (ox * ox + oy * oy + oz * oz - setup.dome_radius * setup.dome_radius);
+        T t2 = -b2 + std::sqrt(std::max(h2, (T) 0));
+        hit = hit && h2 >= 0;
+
+        T ux = (ox + t2 * rx) * inverse_dome_radius;
+        T uy = (oy + t2 * ry) * inverse_dome_radius;
+        T uz = (oz + t2 * rz) * inverse_dome_radius;
+        hit = hit && uy >= min_height;
+        qx[i] = hit ? ux : nan;
+        qz[i] = hit ? uz : nan;
+    }
+}
+
+
+// the dome base position of point of a ring, rings at equal angles from the zenith to the horizon
+glm::dvec2 domeTarget(int ring, int point, int rings, int points_per_ring)
+{
+    double radius = std::sin(ring * PI * 0.5 / rings);
+    double angle = PI - point * 2.0 * PI / points_per_ring;
+    return glm::dvec2(radius * std::cos(angle), radius * std::sin(angle));
+}
+
+// rays through the whole projector image and the nearest of them to the center of every bucket of the dome base
+struct Seeds {
+    std::vector<float> tx;
+    std::vector<float> ty;
+    std::vector<float> qx;
+    std::vector<float> qz;
+    std::vector<int> buckets;
+
+    int nearest(double x, double z) const
+    {
+        int bx = std::min(std::max((int) ((x + 1.0) * 0.5 * BUCKETS), 0), BUCKETS - 1);
+        int bz = std::min(std::max((int) ((z + 1.0) * 0.5 * BUCKETS), 0), BUCKETS - 1);
+        int best = -1;
+        int found_radius = -1;
+        double best_distance = std::numeric_limits<double>::max();
+        // grow the searched square of buckets, the ring after the first hit may still hold a nearer ray
+        for (int radius = 0; radius < BUCKETS && (found_radius < 0 || radius <= found_radius + 1); ++radius) {
+            for (int row = std::max(bz - radius, 0); row <= std::min(bz + radius, BUCKETS - 1); ++row) {
+                for (int column = std::max(bx - radius, 0); column <= std::min(bx + radius, BUCKETS - 1); ++column) {
+                    int i = buckets[(size_t) row * BUCKETS + column];
+                    if ((std::abs(row - bz) != radius && std::abs(column - bx) != radius) || i < 0)
+                        continue;
+                    double distance = (qx[i] - x) * (qx[i] - x) + (qz[i] - z) * (qz[i] - z);
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        best = i;
+                    }
+                }
+            }
+            if (best >= 0 && found_radius < 0)
+                found_radius = radius;
+        }
+        return best;
+    }
+};
+
+void traceGrid(ThreadPool *pool, const WarpGeometry &geometry, Seeds *seeds)
+{
+    Setup<float> setup = makeSetup<float>(geometry);
+    auto tan_y = (float) std::tan(glm::radians(geometry.projector_fov) * 0.5);
+    float tan_x = tan_y * geometry.projector_aspect;
+    int rows = geometry.grid_rows;
+    int columns = geometry.grid_columns;
+    size_t count = (size_t) rows * columns;
+    seeds->tx.resize(count);
+    seeds->ty.resize(count);
+    seeds->qx.resize(count);
+    seeds->qz.resize(count);
+    pool->run(rows, [&](int row) {
+        size_t offset = (size_t) row * columns;
+        for (int column = 0; column < columns; ++column) {
+            seeds->tx[offset + column] = tan_x * (2.0f * column / (columns - 1) - 1.0f);
+            seeds->ty[offset + column] = tan_y * (2.0f * row / (rows - 1) - 1.0f);
+        }
+        trace(setup, &seeds->tx[offset], &seeds->ty[offset], columns, true, &seeds->qx[offset], &seeds->qz[offset]);
+    });
+
+    seeds->buckets.assign((size_t) BUCKETS * BUCKETS, -1);
+    std::vector<float> distances((size_t) BUCKETS * BUCKETS, std::numeric_limits<float>::max());
+    for (size_t i = 0; i < count; ++i) {
+        if (std::isnan(seeds->qx[i]))
+            continue;
+        float x = (seeds->qx[i] + 1.0f) * 0.5f * BUCKETS;
+        float z = (seeds->qz[i] + 1.0f) * 0.5f * BUCKETS;
+        int bx = std::min(std::max((int) x, 0), BUCKETS - 1);
+        int bz = std::min(std::max((int) z, 0), BUCKETS - 1);
+        float distance = (x - bx - 0.5f) * (x - bx - 0.5f) + (z - bz - 0.5f) * (z - bz - 0.5f);
+        size_t bucket = (size_t) bz * BUCKETS + bx;
+        if (distance < distances[bucket]) {
+            distances[bucket] = distance;
+            seeds->buckets[bucket] = (int) i;
+        }
+    }
+}
+}
+
+WarpGenerator::WarpGenerator(int threads)
+        : pool_(threads)
+{
+}
+
+bool WarpGenerator::parse(const json11::Json &config, WarpGeometry *geometry)
+{
+    const json11::Json &projector = config["projector"];
+    auto vec3 = [](const json11::Json &json) {
+        return glm::vec3((float) json["x"].number_value(), (float) json["y"].number_value(),
+                         (float) json["z"].number_value());
+    };
+
+    geometry->projector_position = vec3(projector["position"]);
+    geometry->projector_rotation = vec3(projector["rotation"]);
+    geometry->projector_fov = (float) projector["fov"]["fov"].number_value();
+    int screen_width = projector["screen"]["w"].int_value();
+    int screen_height = projector["screen"]["h"].int_value();
+    geometry->projector_aspect = screen_width > 0 && screen_height > 0 ? (float) screen_width / screen_height
+                                                                      : 16.0f / 9.0f;
+    geometry->mirror_position = vec3(config["mirror"]["position"]);
+    geometry->mirror_radius = (float) config["mirror"]["radius"]["radius"].number_value();
+    geometry->dome_position = vec3(config["dome"]["position"]);
+    geometry->dome_radius = (float) config["dome"]["radius"]["radius"].number_value();
+    geometry->grid_rows = projector["grid"]["rings"].int_value();
+    geometry->grid_columns = projector["grid"]["ring_elements"].int_value();
+    geometry->rings = projector["mesh"]["rings"].int_value();
+    geometry->points_per_ring = projector["mesh"]["ring_elements"].int_value();
+
+    if (geometry->projector_fov <= 0.0f || geometry->projector_fov >= 180.0f || geometry->mirror_radius <= 0.0f ||
+        geometry->dome_radius <= 0.0f || geometry->grid_rows < 2 || geometry->grid_columns < 2 ||
+        geometry->rings < 1 || geometry->points_per_ring < 3) {
+        std::cout << "Generator: the config lacks projector fov, grid or mesh, mirror or dome radius" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WarpGenerator::generate(const WarpGeometry &geometry, std::vector<glm::vec3> *points,
+                             std::vector<glm::vec3> *uvs)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<glm::dvec2> tangents;
+    if (!solve(geometry, &tangents))
+        return false;
+
+    points->resize(tangents.size());
+    for (size_t i = 0; i < tangents.size(); ++i)
+        (*points)[i] = glm::vec3(geometry.projector_position.x + (float) tangents[i].x,
+                                 geometry.projector_position.y + (float) tangents[i].y, 0.0f);
+    textureCoordinates(geometry, uvs);
+
+    std::cout << "Generator: " << geometry.rings << " rings of " << geometry.points_per_ring << " from "
+              << geometry.grid_rows << "x" << geometry.grid_columns << " rays in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms" << std::endl;
+    return true;
+}
+
+bool WarpGenerator::solve(const WarpGeometry &geometry, std::vector<glm::dvec2> *tangents)
+{
+    Setup<double> setup = makeSetup<double>(geometry);
+    auto tan_y = std::tan(glm::radians((double) geometry.projector_fov) * 0.5);
+    double tan_x = tan_y * geometry.projector_aspect;
+    int rings = geometry.rings;
+    int points_per_ring = geometry.points_per_ring;
+    size_t count = 1 + (size_t) rings * points_per_ring;
+
+    // previous solutions are only a start for a pose nearby, a different layout starts from scratch
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (tangents->size() != count)
+        tangents->assign(count, glm::dvec2(nan, nan));
+    std::vector<char> solved(count, 0);
+    std::vector<char> outside(count, 0);
+
+    // Newton steps on the exact trace from the current tangent, halved while they do not get closer
+    auto refine = [&](size_t i, double target_x, double target_z) {
+        double tx = (*tangents)[i].x, ty = (*tangents)[i].y;
+        if (std::isnan(tx))
+            return;
+
+        double qx, qz;
+        trace(setup, &tx, &ty, 1, false, &qx, &qz);
+        double error = std::hypot(qx - target_x, qz - target_z);
+        for (int iteration = 0; iteration < MAX_ITERATIONS && error > TOLERANCE; ++iteration) {
+            double x_x, x_z, y_x, y_z;
+            double step_x = tx + DERIVATIVE_STEP, step_y = ty + DERIVATIVE_STEP;
+            trace(setup, &step_x, &ty, 1, false, &x_x, &x_z);
+            trace(setup, &tx, &step_y, 1, false, &y_x, &y_z);
+            double j00 = (x_x - qx) / DERIVATIVE_STEP, j01 = (y_x - qx) / DERIVATIVE_STEP;
+            double j10 = (x_z - qz) / DERIVATIVE_STEP, j11 = (y_z - qz) / DERIVATIVE_STEP;
+            double determinant = j00 * j11 - j01 * j10;
+            if (!(std::abs(determinant) > 0.0))
+                break;
+
+            double ex = target_x - qx, ez = target_z - qz;
+            double dx = (j11 * ex - j01 * ez) / determinant;
+            double dy = (j00 * ez - j10 * ex) / determinant;
+            bool improved = false;
+            for (int halving = 0; halving < 10 && !improved; ++halving, dx *= 0.5, dy *= 0.5) {
+                double next_x = tx + dx, next_y = ty + dy, next_qx, next_qz;
+                trace(setup, &next_x, &next_y, 1, false, &next_qx, &next_qz);
+                double next_error = std::hypot(next_qx - target_x, next_qz - target_z);
+                if (next_error < error) {
+                    tx = next_x;
+                    ty = next_y;
+                    qx = next_qx;
+                    qz = next_qz;
+                    error = next_error;
+                    improved = true;
+                }
+            }
+            if (!improved)
+                break;
+        }
+        if (!(error <= TOLERANCE))
+            return;
+
+        (*tangents)[i] = glm::dvec2(tx, ty);
+        solved[i] = 1;
+        outside[i] = std::abs(tx) > tan_x || std::abs(ty) > tan_y;
+    };
+
+    // the zenith first, then every ring on its own
+    auto refine_all = [&](const std::function<void(size_t)> &seed) {
+        pool_.run(rings + 1, [&](int task) {
+            if (task == 0) {
+                if (!solved[0]) {
+                    seed(0);
+                    refine(0, 0.0, 0.0);
+                }
+                return;
+            }
+            int ring = task - 1;
+            for (int point = 0; point < points_per_ring; ++point) {
+                size_t i = 1 + (size_t) ring * points_per_ring + point;
+                if (solved[i])
+                    continue;
+                glm::dvec2 target = domeTarget(ring + 1, point, rings, points_per_ring);
+                seed(i);
+                refine(i, target.x, target.y);
+            }
+        });
+    };
+
+    // a small pose change only needs a step or two from the previous solution
+    refine_all([](size_t) {});
+
+    if (std::count(solved.begin(), solved.end(), 0) > 0) {
+        Seeds seeds;
+        traceGrid(&pool_, geometry, &seeds);
+        refine_all([&](size_t i) {
+            glm::dvec2 target = i == 0 ? glm::dvec2(0.0, 0.0)
+                                       : domeTarget((int) ((i - 1) / points_per_ring) + 1,
+                                                    (int) ((i - 1) % points_per_ring), rings, points_per_ring);
+            int guess = seeds.nearest(target.x, target.y);
+            (*tangents)[i] = guess < 0 ? glm::dvec2(nan, nan) : glm::dvec2(seeds.tx[guess], seeds.ty[guess]);
+        });
+    }
+
+    auto unsolved = std::count(solved.begin(), solved.end(), 0);
+    if (unsolved > 0) {
+        std::cout << "Generator: " << unsolved << " of " << count << " dome points are not reached by the projector"
+                  << std::endl;
+        return false;
+    }
+
+    auto beyond = std::count(outside.begin(), outside.end(), 1);
+    if (beyond > 0)
+        std::cout << "Generator: " << beyond << " points lie outside the projector image" << std::endl;
+    return true;
+}
+
+void WarpGenerator::textureCoordinates(const WarpGeometry &geometry, std::vector<glm::vec3> *uvs)
+{
+    uvs->resize(1 + (size_t) geometry.rings * geometry.points_per_ring);
+    (*uvs)[0] = glm::vec3(0.5f, 0.5f, 0.0f);
+    for (int ring = 0; ring < geometry.rings; ++ring) {
+        for (int point = 0; point < geometry.points_per_ring; ++point) {
+            glm::dvec2 target = domeTarget(ring + 1, point, geometry.rings, geometry.points_per_ring);
+            (*uvs)[1 + (size_t) ring * geometry.points_per_ring + point] =
+                    glm::vec3((float) (0.5 + 0.5 * target.x), (float) (0.5 + 0.5 * target.y), 0.0f);
+        }
+    }
+}
+
+bool WarpGenerator::generate(const json11::Json &config, bool optimize, WarpMeshData *data)
+{
+    WarpGeometry geometry;
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> uvs;
+    if (!parse(config, &geometry) || !generate(geometry, &points, &uvs))
+        return false;
+
+    MeshBuilder builder(geometry.rings, geometry.points_per_ring);
+    if (!builder.build(points, uvs, &data->vertices, &data->indices, 0))
+        return false;
+
+    if (optimize)
+        MeshLoader::optimize(&data->vertices, &data->indices);
+    return true;
+}
+
+int WarpGenerator::threadCount() const
+{
+    return pool_.threadCount();
+}
@@ -0,0 +1,271 @@
+#include "../inc/warp_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// points per task of a batched query
+const size_t QUERY_BATCH_SIZE = 4096;
+
+struct WindowVertex {
+    float x;
+    float y;
+    float z;
+    float inverse_w;
+};
+
+}
+
+const int WarpIndex::MIN_CELL_SIZE;
+const int WarpIndex::MAX_CELL_SIZE;
+
+WarpIndex::WarpIndex()
+        : mutex_(),
+          mesh_(),
+          mvp_(1.0f),
+          width_(0),
+          height_(0),
+          dirty_(true),
+          grid_()
+{
+}
+
+void WarpIndex::setMesh(const WarpMeshData &mesh)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    mesh_ = mesh;
+    dirty_ = true;
+}
+
+void WarpIndex::updateVertices(size_t first, const WarpVertex *vertices, size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (first + count > mesh_.vertices.size())
+        return;
+
+    std::copy(vertices, vertices + count, mesh_.vertices.begin() + first);
+    dirty_ = true;
+}
+
+void WarpIndex::setView(const glm::mat4 &mvp, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mvp == mvp_ && width == width_ && height == height_)
+        return;
+
+    mvp_ = mvp;
+    width_ = width;
+    height_ = height;
+    dirty_ = true;
+}
+
+bool WarpIndex::query(float x, float y, glm::vec2 *uv)
+{
+    std::shared_ptr<const Grid> grid = current();
+    return lookup(*grid, x, y, uv);
+}
+
+size_t WarpIndex::query(const glm::vec2 *points, size_t count, glm::vec2 *uvs, ThreadPool *pool)
+{
+    std::shared_ptr<const Grid> grid = current();
+
+    auto batches = (int) ((count + QUERY_BATCH_SIZE - 1) / QUERY_BATCH_SIZE);
+    std::vector<size_t> inside((size_t) batches, 0);
+    auto query_batch = [&](int batch) {
+        size_t end = std::min((size_t) (batch + 1) * QUERY_BATCH_SIZE, count);
+        for (size_t i = (size_t) batch * QUERY_BATCH_SIZE; i < end; ++i) {
+            if (lookup(*grid, points[i].x, points[i].y, &uvs[i]))
+                ++inside[batch];
+            else
+                uvs[i] = glm::vec2(-1.0f, 0.0f);
+        }
+    };
+
+    if (pool && pool->threadCount() > 1 && batches > 1) {
+        pool->run(batches, query_batch);
+    } else {
+        for (int batch = 0; batch < batches; ++batch)
+            query_batch(batch);
+    }
+
+    size_t total = 0;
+    for (size_t batch_inside : inside)
+        total += batch_inside;
+    return total;
+}
+
+int WarpIndex::triangleCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (int) (mesh_.indices.size() / 3);
+}
+
+std::shared_ptr<const WarpIndex::Grid> WarpIndex::current()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dirty_) {
+        // a grid that running queries still hold is left to them, otherwise its storage is reused
+        if (!grid_ || grid_.use_count() > 1)
+            grid_ = std::make_shared<Grid>();
+        build(grid_.get());
+        dirty_ = false;
+    }
+    return grid_;
+}
+
+void WarpIndex::build(Grid *grid) const
+{
+    grid->triangles.clear();
+    grid->columns = 0;
+    grid->rows = 0;
+    grid->cell_start.clear();
+    grid->cell_triangles.clear();
+    if (width_ <= 0 || height_ <= 0)
+        return;
+
+    // clip space to output pixels, rows top-down
+    std::vector<WindowVertex> window(mesh_.vertices.size());
+    for (size_t i = 0; i < mesh_.vertices.size(); ++i) {
+        const WarpVertex &vertex = mesh_.vertices[i];
+        glm::vec4 clip = mvp_ * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f);
+        if (clip.w <= 0.0f) {
+            // behind the camera, triangles using it are dropped like in the software renderer
+            window[i] = {0.0f, 0.0f, 0.0f, 0.0f};
+            continue;
+        }
+        float inverse_w = 1.0f / clip.w;
+        window[i] = {(clip.x * inverse_w * 0.5f + 0.5f) * (float) width_,
+                     (0.5f - clip.y * inverse_w * 0.5f) * (float) height_,
+                     clip.z * inverse_w * 0.5f + 0.5f, inverse_w};
+    }
+
+    // keep the triangles that reach into the output, in draw order
+    float min_x = (float) width_, min_y = (float) height_, max_x = 0.0f, max_y = 0.0f;
+    double side_sum = 0.0;
+    for (size_t i = 0; i + 2 < mesh_.indices.size(); i += 3) {
+        uint32_t index[3] = {mesh_.indices[i], mesh_.indices[i + 1], mesh_.indices[i + 2]};
+        const WindowVertex *v[3] = {&window[index[0]], &window[index[1]], &window[index[2]]};
+        if (v[0]->inverse_w == 0.0f || v[1]->inverse_w == 0.0f || v[2]->inverse_w == 0.0f)
+            continue;
+
+        float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[1]->y - v[0]->y) * (v[2]->x - v[0]->x);
+        if (area == 0.0f)
+            continue;
+
+        float left = std::min(std::min(v[0]->x, v[1]->x), v[2]->x);
+        float right = std::max(std::max(v[0]->x, v[1]->x), v[2]->x);
+        float top = std::min(std::min(v[0]->y, v[1]->y), v[2]->y);
+        float bottom = std::max(std::max(v[0]->y, v[1]->y), v[2]->y);
+        if (right < 0.0f || left > (float) width_ || bottom < 0.0f || top > (float) height_)
+            continue;
+
+        // one winding for all, so inside is positive for every edge
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            std::swap(index[1], index[2]);
+            area = -area;
+        }
+
+        Triangle triangle;
+        for (int k = 0; k < 3; ++k) {
+            const WarpVertex &vertex = mesh_.vertices[index[k]];
+            triangle.x[k] = v[k]->x;
+            triangle.y[k] = v[k]->y;
+            triangle.z[k] = v[k]->z;
+            triangle.inverse_w[k] = v[k]->inverse_w;
+            triangle.u_w[k] = vertex.u * v[k]->inverse_w;
+            triangle.t_w[k] = (1.0f - vertex.v) * v[k]->inverse_w;
+        }
+        triangle.inverse_area = 1.0f / area;
+        grid->triangles.push_back(triangle);
+
+        min_x = std::min(min_x, left);
+        min_y = std::min(min_y, top);
+        max_x = std::max(max_x, right);
+        max_y = std::max(max_y, bottom);
+        side_sum += std::sqrt((double) (right - left) * (bottom - top));
+    }
+    if (grid->triangles.empty())
+        return;
+
+    // cells about the size of an average triangle keep the lists short without wasting memory on empty cells
+    double mean_side = side_sum / (double) grid->triangles.size();
+    int cell_size = std::max(MIN_CELL_SIZE, std::min(MAX_CELL_SIZE, (int) std::ceil(mean_side)));
+    grid->origin_x = std::floor(std::max(min_x, 0.0f));
+    grid->origin_y = std::floor(std::max(min_y, 0.0f));
+    grid->inverse_cell_size = 1.0f / (float) cell_size;
+    grid->columns = (int) std::ceil((std::min(max_x, (float) width_) - grid->origin_x) / (float) cell_size) + 1;
+    grid->rows = (int) std::ceil((std::min(max_y, (float) height_) - grid->origin_y) / (float) cell_size) + 1;
+
+    auto cell_range = [grid](const Triangle &triangle, int *column_begin, int *column_end, int *row_begin,
+                             int *row_end) {
+        float left = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+        float right = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+        float top = std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]);
+        float bottom = std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]);
+        *column_begin = std::max((int) ((left - grid->origin_x) * grid->inverse_cell_size), 0);
+        *column_end = std::min((int) ((right - grid->origin_x) * grid->inverse_cell_size) + 1, grid->columns);
+        *row_begin = std::max((int) ((top - grid->origin_y) * grid->inverse_cell_size), 0);
+        *row_end = std::min((int) ((bottom - grid->origin_y) * grid->inverse_cell_size) + 1, grid->rows);
+    };
+
+    // count the triangles per cell, then place them, both passes in draw order
+    grid->cell_start.assign((size_t) grid->columns * grid->rows + 1, 0);
+    int column_begin, column_end, row_begin, row_end;
+    for (const Triangle &triangle : grid->triangles) {
+        cell_range(triangle, &column_begin, &column_end, &row_begin, &row_end);
+        for (int row = row_begin; row < row_end; ++row)
+            for (int column = column_begin; column < column_end; ++column)
+                ++grid->cell_start[(size_t) row * grid->columns + column + 1];
+    }
+    for (size_t i = 1; i < grid->cell_start.size(); ++i)
+        grid->cell_start[i] += grid->cell_start[i - 1];
+
+    grid->cell_triangles.resize(grid->cell_start.back());
+    std::vector<uint32_t> fill(grid->cell_start.begin(), grid->cell_start.end() - 1);
+    for (size_t i = 0; i < grid->triangles.size(); ++i) {
+        cell_range(grid->triangles[i], &column_begin, &column_end, &row_begin, &row_end);
+        for (int row = row_begin; row < row_end; ++row)
+            for (int column = column_begin; column < column_end; ++column)
+                grid->cell_triangles[fill[(size_t) row * grid->columns + column]++] = (uint32_t) i;
+    }
+}
+
+bool WarpIndex::lookup(const Grid &grid, float x, float y, glm::vec2 *uv)
+{
+    float cell_x = (x - grid.origin_x) * grid.inverse_cell_size;
+    float cell_y = (y - grid.origin_y) * grid.inverse_cell_size;
+    if (!(cell_x >= 0.0f && cell_y >= 0.0f && cell_x < (float) grid.columns && cell_y < (float) grid.rows))
+        return false;
+
+    size_t cell = (size_t) cell_y * grid.columns + (size_t) cell_x;
+    float nearest = 1.0f;
+    bool found = false;
+    for (uint32_t i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; ++i) {
+        const Triangle &triangle = grid.triangles[grid.cell_triangles[i]];
+        float e0 = (triangle.x[2] - triangle.x[1]) * (y - triangle.y[1]) -
+                   (triangle.y[2] - triangle.y[1]) * (x - triangle.x[1]);
+        float e1 = (triangle.x[0] - triangle.x[2]) * (y - triangle.y[2]) -
+                   (triangle.y[0] - triangle.y[2]) * (x - triangle.x[2]);
+        float e2 = (triangle.x[1] - triangle.x[0]) * (y - triangle.y[0]) -
+                   (triangle.y[1] - triangle.y[0]) * (x - triangle.x[0]);
+        if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+            continue;
+
+        // the first triangle in draw order wins equal depths, like GL_LESS
+        float b0 = e0 * triangle.inverse_area;
+        float b1 = e1 * triangle.inverse_area;
+        float b2 = e2 * triangle.inverse_area;
+        float z = b0 * triangle.z[0] + b1 * triangle.z[1] + b2 * triangle.z[2];
+        if (z < 0.0f || z >= nearest)
+            continue;
+        nearest = z;
+
+        float inverse_w = b0 * triangle.inverse_w[0] + b1 * triangle.inverse_w[1] + b2 * triangle.inverse_w[2];
+        uv->x = (b0 * triangle.u_w[0] + b1 * triangle.u_w[1] + b2 * triangle.u_w[2]) / inverse_w;
+        uv->y = (b0 * triangle.t_w[0] + b1 * triangle.t_w[1] + b2 * triangle.t_w[2]) / inverse_w;
+        found = true;
+    }
+    return found;
+}
@@ -0,0 +1,177 @@
+#include "../inc/warp_lut.h"
+#include "../inc/shader.h"
+
+#include <iostream>
+
+WarpLut::WarpLut()
+        : width_(0),
+          height_(0),
+          lookup_texture_(0),
+          depth_buffer_(0),
+          framebuffer_(0),
+          bake_program_(0),
+          bake_mvp_id_(-1),
+          warp_program_(0),
+          lookup_sampler_id_(-1),
+          texture_sampler_id_(-1),
+          baked_(false),
+          baked_mvp_(1.0f),
+          baked_generation_(0)
+{
+}
+
+WarpLut::~WarpLut()
+{
+    release();
+}
+
+bool WarpLut::init(int width, int height)
+{
+    release();
+    width_ = width;
+    height_ = height;
+
+    bake_program_ = Shader::loadShaders("shader/simple.vert", "shader/lut_bake.frag");
+    warp_program_ = Shader::loadShaders("shader/lut_warp.vert", "shader/lut_warp.frag");
+    if (!bake_program_ || !warp_program_) {
+        std::cout << "Lut: unable to load shaders" << std::endl;
+        release();
+        return false;
+    }
+    bake_mvp_id_ = glGetUniformLocation(bake_program_, "MVP");
+    lookup_sampler_id_ = glGetUniformLocation(warp_program_, "lookupSampler");
+    texture_sampler_id_ = glGetUniformLocation(warp_program_, "myTextureSampler");
+
+    // the lookup is read with texelFetch, so it is never filtered
+    glGenTextures(1, &lookup_texture_);
+    glBindTexture(GL_TEXTURE_2D, lookup_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width_, height_, 0, GL_RG, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // overlapping parts of the mesh are resolved by depth just like in the direct mode
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lookup_texture_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Lut: RG32F framebuffer is not supported" << std::endl;
+        release();
+        return false;
+    }
+
+    std::cout << "Lut: " << width_ << "x" << height_ << " lookup texture" << std::endl;
+    return true;
+}
+
+void WarpLut::release()
+{
+    if (framebuffer_) {
+        glDeleteFramebuffers(1, &framebuffer_);
+        framebuffer_ = 0;
+    }
+    if (depth_buffer_) {
+        glDeleteRenderbuffers(1, &depth_buffer_);
+        depth_buffer_ = 0;
+    }
+    if (lookup_texture_) {
+        glDeleteTextures(1, &lookup_texture_);
+        lookup_texture_ = 0;
+    }
+    if (bake_program_) {
+        glDeleteProgram(bake_program_);
+        bake_program_ = 0;
+    }
+    if (warp_program_) {
+        glDeleteProgram(warp_program_);
+        warp_program_ = 0;
+    }
+    baked_ = false;
+}
+
+void WarpLut::resize(int width, int height)
+{
+    if (!framebuffer_ || (width == width_ && height == height_))
+        return;
+    width_ = width;
+    height_ = height;
+
+    // the framebuffer keeps its attachments, only their storage is replaced
+    glBindTexture(GL_TEXTURE_2D, lookup_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width_, height_, 0, GL_RG, GL_FLOAT, nullptr);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+    baked_ = false;
+
+    std::cout << "Lut: resized to " << width_ << "x" << height_ << std::endl;
+}
+
+bool WarpLut::update(const WarpMesh &mesh, const glm::mat4 &mvp)
+{
+    if (!framebuffer_ || (baked_ && mvp == baked_mvp_ && mesh.generation() == baked_generation_))
+        return false;
+
+    bake(mesh, mvp);
+    return true;
+}
+
+void WarpLut::draw(GLuint texture) const
+{
+    if (!framebuffer_)
+        return;
+
+    glUseProgram(warp_program_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lookup_texture_);
+    glUniform1i(lookup_sampler_id_, 1);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(texture_sampler_id_, 0);
+
+    // every pixel is written once, depth is of no use here
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (depth_test)
+        glEnable(GL_DEPTH_TEST);
+}
+
+void WarpLut::bake(const WarpMesh &mesh, const glm::mat4 &mvp)
+{
+    GLint viewport[4];
+    GLint framebuffer;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+
+    // pixels the mesh does not reach keep a negative coordinate and stay black
+    GLfloat clear_color[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    glClearColor(-1.0f, -1.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glUseProgram(bake_program_);
+    glUniformMatrix4fv(bake_mvp_id_, 1, GL_FALSE, &mvp[0][0]);
+    mesh.draw(false);
+    if (!depth_test)
+        glDisable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint) framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    baked_ = true;
+    baked_mvp_ = mvp;
+    baked_generation_ = mesh.generation();
+}
@@ -0,0 +1,346 @@
+#include "../inc/warp_mesh.h"
+#include "../inc/mesh_file.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+WarpMesh::WarpMesh()
+        : vertices_(),
+          indices_(),
+          buffers_(),
+          front_(0),
+          generation_(0),
+          staged_(),
+          staged_edges_(),
+          staged_indices_(),
+          staged_offset_(0),
+          staging_(false),
+          optimize_(false)
+{
+    for (Buffers &buffers : buffers_)
+        buffers = {0, 0, 0, 0, GL_UNSIGNED_INT, 0, 0};
+}
+
+WarpMesh::~WarpMesh()
+{
+    release();
+}
+
+bool WarpMesh::load(const char *mesh_path, const char *tex_path)
+{
+    WarpMeshData data;
+    if (!MeshLoader::load(mesh_path, tex_path, optimize_, &data))
+        return false;
+
+    vertices_ = std::move(data.vertices);
+    indices_ = std::move(data.indices);
+    return upload();
+}
+
+bool WarpMesh::loadBinary(const char *path)
+{
+    MeshFile file;
+    if (!file.open(path))
+        return false;
+
+    const MeshFileHeader &header = file.header();
+    std::cout << "Mesh: mapped '" << path << "' with " << header.rings << " rings of " << header.points_per_ring
+              << std::endl;
+
+    // the stored order is used unless an optimisation was asked for that the file does not have yet
+    bool optimized = (header.flags & MeshFile::FLAG_OPTIMIZED) != 0;
+    if (header.index_count > 0 && (optimized || !optimize_)) {
+        // the copy in memory serves lookups and in place updates as for every other mesh
+        vertices_.assign(file.vertices(), file.vertices() + header.vertex_count);
+        if (header.index_size == sizeof(uint16_t)) {
+            auto indices = (const uint16_t *) file.indices();
+            indices_.assign(indices, indices + header.index_count);
+        } else {
+            auto indices = (const uint32_t *) file.indices();
+            indices_.assign(indices, indices + header.index_count);
+        }
+        return upload();
+    }
+
+    MeshBuilder builder((int) header.rings, (int) header.points_per_ring);
+    vertices_.assign(file.vertices(), file.vertices() + header.vertex_count);
+    builder.buildIndices(&indices_);
+    if (optimize_)
+        MeshLoader::optimize(&vertices_, &indices_);
+    return upload();
+}
+
+bool WarpMesh::build(const std::vector<glm::vec3> &points, const std::vector<glm::vec3> &uvs, int rings,
+                     int points_per_ring, int threads)
+{
+    MeshBuilder builder(rings, points_per_ring);
+    if (!builder.build(points, uvs, &vertices_, &indices_, threads))
+        return false;
+
+    if (optimize_)
+        MeshLoader::optimize(&vertices_, &indices_);
+
+    return upload();
+}
+
+void WarpMesh::release()
+{
+    for (Buffers &buffers : buffers_) {
+        if (buffers.vertex_buffer)
+            glDeleteBuffers(1, &buffers.vertex_buffer);
+        if (buffers.edge_buffer)
+            glDeleteBuffers(1, &buffers.edge_buffer);
+        if (buffers.index_buffer)
+            glDeleteBuffers(1, &buffers.index_buffer);
+        if (buffers.vertex_array)
+            glDeleteVertexArrays(1, &buffers.vertex_array);
+        buffers = {0, 0, 0, 0, GL_UNSIGNED_INT, 0, 0};
+    }
+    staging_ = false;
+    staged_ = WarpMeshData();
+    staged_edges_.clear();
+    staged_indices_.clear();
+}
+
+void WarpMesh::setOptimize(bool optimize)
+{
+    optimize_ = optimize;
+}
+
+void WarpMesh::stage(WarpMeshData &&data)
+{
+    staged_ = std::move(data);
+    staged_edges_ = edgeAttribute(staged_.indices, staged_.vertices.size());
+    size_t index_size;
+    staged_indices_ = packIndices(staged_.indices, staged_.vertices.size(), &index_size);
+
+    // only the storage is allocated here, the contents follow in continueStaging()
+    allocate(&back(), nullptr, nullptr, staged_.vertices.size(), nullptr, staged_.indices.size(), index_size);
+    staged_offset_ = 0;
+    staging_ = true;
+}
+
+bool WarpMesh::continueStaging(size_t max_bytes)
+{
+    if (!staging_)
+        return false;
+
+    // the vertices, their edge attribute and the indices are streamed one after another
+    Buffers &buffers = back();
+    struct Part {
+        GLenum target;
+        GLuint buffer;
+        const unsigned char *data;
+        size_t size;
+    };
+    const Part parts[] = {
+            {GL_ARRAY_BUFFER, buffers.vertex_buffer, (const unsigned char *) staged_.vertices.data(),
+             staged_.vertices.size() * sizeof(WarpVertex)},
+            {GL_ARRAY_BUFFER, buffers.edge_buffer, (const unsigned char *) staged_edges_.data(),
+             staged_edges_.size() * sizeof(float)},
+            {GL_COPY_WRITE_BUFFER, buffers.index_buffer, staged_indices_.data(), staged_indices_.size()}};
+    size_t total_bytes = 0;
+    for (const Part &part : parts)
+        total_bytes += part.size;
+    size_t end = std::min(staged_offset_ + max_bytes, total_bytes);
+
+    size_t part_start = 0;
+    for (const Part &part : parts) {
+        size_t part_end = part_start + part.size;
+        if (staged_offset_ < end && staged_offset_ < part_end) {
+            size_t write_end = std::min(end, part_end);
+            glBindBuffer(part.target, part.buffer);
+            glBufferSubData(part.target, (GLintptr) (staged_offset_ - part_start),
+                            (GLsizeiptr) (write_end - staged_offset_), part.data + (staged_offset_ - part_start));
+            staged_offset_ = write_end;
+        }
+        part_start = part_end;
+    }
+    if (staged_offset_ < total_bytes)
+        return false;
+
+    vertices_ = std::move(staged_.vertices);
+    indices_ = std::move(staged_.indices);
+    staged_edges_.clear();
+    staged_indices_.clear();
+    staging_ = false;
+    swap();
+    return true;
+}
+
+bool WarpMesh::isStaging() const
+{
+    return staging_;
+}
+
+bool WarpMesh::updateVertices(size_t first, const WarpVertex *vertices, size_t count)
+{
+    const Buffers &buffers = buffers_[front_];
+    if (!buffers.vertex_buffer || first + count > buffers.vertex_count)
+        return false;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) (first * sizeof(WarpVertex)), (GLsizeiptr) (count * sizeof(WarpVertex)),
+                    vertices);
+    if (vertices_.size() == buffers.vertex_count)
+        std::copy(vertices, vertices + count, vertices_.begin() + first);
+
+    // the mesh changed for everything that caches its rendering
+    ++generation_;
+    return true;
+}
+
+bool WarpMesh::copyData(WarpMeshData *data) const
+{
+    if (vertices_.empty())
+        return false;
+
+    data->vertices = vertices_;
+    data->indices = indices_;
+    return true;
+}
+
+int WarpMesh::draw(bool points) const
+{
+    const Buffers &buffers = buffers_[front_];
+    if (!buffers.vertex_buffer)
+        return 0;
+
+    // the vertex array holds the whole vertex setup
+    glBindVertexArray(buffers.vertex_array);
+
+    // every point once, the triangles share them through the index buffer
+    if (points)
+        glDrawArrays(GL_POINTS, 0, (GLsizei) buffers.vertex_count);
+    else
+        glDrawElements(GL_TRIANGLES, (GLsizei) buffers.index_count, buffers.index_type, (void *) 0);
+    return 2;
+}
+
+int WarpMesh::vertexCount() const
+{
+    return (int) buffers_[front_].vertex_count;
+}
+
+int WarpMesh::triangleCount() const
+{
+    return (int) buffers_[front_].index_count / 3;
+}
+
+unsigned long WarpMesh::generation() const
+{
+    return generation_;
+}
+
+std::vector<float> WarpMesh::edgeAttribute(const std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    // all triangles are wound alike, so around an inner point every neighbour follows it in one triangle and
+    // precedes it in the next. Only the two border neighbours of a border point lack one of these, the sums of
+    // following and preceding neighbours differ just there. For the ring layout these are the points of the
+    // outer ring, wherever an optimised vertex order put them.
+    std::vector<int64_t> balance(vertex_count, 0);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t next = indices[i + (corner + 1) % 3];
+            uint32_t previous = indices[i + (corner + 2) % 3];
+            balance[indices[i + corner]] += (int64_t) next - (int64_t) previous;
+        }
+    }
+
+    std::vector<float> edges(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i)
+        edges[i] = balance[i] == 0 ? 1.0f : 0.0f;
+    return edges;
+}
+
+std::vector<unsigned char> WarpMesh::packIndices(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                                 size_t *index_size)
+{
+    // 16 bit indices halve the index fetch for all but huge meshes
+    *index_size = vertex_count <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+    std::vector<unsigned char> packed(indices.size() * *index_size);
+    if (*index_size == sizeof(uint32_t)) {
+        std::memcpy(packed.data(), indices.data(), packed.size());
+    } else {
+        auto short_indices = (uint16_t *) packed.data();
+        for (size_t i = 0; i < indices.size(); ++i)
+            short_indices[i] = (uint16_t) indices[i];
+    }
+    return packed;
+}
+
+bool WarpMesh::upload()
+{
+    std::vector<float> edges = edgeAttribute(indices_, vertices_.size());
+    size_t index_size;
+    std::vector<unsigned char> packed = packIndices(indices_, vertices_.size(), &index_size);
+
+    // a direct upload supersedes a mesh that is still being staged
+    staging_ = false;
+    allocate(&back(), vertices_.data(), edges.data(), vertices_.size(), packed.data(), indices_.size(), index_size);
+    swap();
+    return true;
+}
+
+WarpMesh::Buffers &WarpMesh::back()
+{
+    return buffers_[front_ ^ 1];
+}
+
+void WarpMesh::allocate(Buffers *buffers, const void *vertices, const void *edges, size_t vertex_count,
+                        const void *indices, size_t index_count, size_t index_size)
+{
+    if (!buffers->vertex_buffer)
+        glGenBuffers(1, &buffers->vertex_buffer);
+    if (!buffers->edge_buffer)
+        glGenBuffers(1, &buffers->edge_buffer);
+    if (!buffers->index_buffer)
+        glGenBuffers(1, &buffers->index_buffer);
+    if (!buffers->vertex_array)
+        bake(buffers);
+
+    // respecifying the storage orphans whatever the GPU may still read from the previous contents. The index
+    // buffer is written through the copy target, binding it as element array would change the bound vertex array.
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(WarpVertex), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->edge_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(float), edges, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers->index_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, index_count * index_size, indices, GL_STATIC_DRAW);
+
+    buffers->index_type = index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    buffers->vertex_count = vertex_count;
+    buffers->index_count = index_count;
+}
+
+void WarpMesh::bake(Buffers *buffers)
+{
+    // the buffer names never change, only their storage, so the vertex array stays valid for every later mesh
+    GLint bound;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bound);
+
+    glGenVertexArrays(1, &buffers->vertex_array);
+    glBindVertexArray(buffers->vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->vertex_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(WarpVertex), (void *) offsetof(WarpVertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(WarpVertex), (void *) offsetof(WarpVertex, u));
+    // only read by the edge antialiasing shaders
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->edge_buffer);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void *) 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->index_buffer);
+
+    glBindVertexArray((GLuint) bound);
+}
+
+void WarpMesh::swap()
+{
+    front_ ^= 1;
+    ++generation_;
+    std::cout << "Mesh: " << vertexCount() << " vertices, " << triangleCount() << " triangles" << std::endl;
+}
@@ -0,0 +1,197 @@
+#include "../inc/warp_updater.h"
+
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+// points that moved less than this in mesh units, far below a pixel, are not uploaded again
+const float UPDATE_THRESHOLD = 1e-6f;
+
+}
+
+WarpUpdater::WarpUpdater()
+        : generator_(),
+          tangents_(),
+          uvs_(),
+          configured_points_(),
+          uploaded_points_(),
+          mutex_(),
+          wake_(),
+          geometry_(),
+          position_(0.0f),
+          rotation_(0.0f),
+          changed_(false),
+          reset_(false),
+          replaced_(false),
+          spans_(),
+          thread_(),
+          running_(false)
+{
+}
+
+WarpUpdater::~WarpUpdater()
+{
+    stop();
+}
+
+bool WarpUpdater::start(const WarpGeometry &geometry)
+{
+    stop();
+
+    running_ = true;
+    setGeometry(geometry);
+    thread_ = std::thread(&WarpUpdater::run, this);
+    return true;
+}
+
+void WarpUpdater::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void WarpUpdater::setGeometry(const WarpGeometry &geometry)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        geometry_ = geometry;
+        position_ = geometry.projector_position;
+        rotation_ = glm::vec3(0.0f);
+        changed_ = true;
+        reset_ = true;
+        spans_.clear();
+    }
+    wake_.notify_all();
+}
+
+void WarpUpdater::setPose(const glm::vec3 &position, const glm::vec3 &rotation)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (position == position_ && rotation == rotation_)
+            return;
+        position_ = position;
+        rotation_ = rotation;
+        changed_ = true;
+    }
+    wake_.notify_all();
+}
+
+void WarpUpdater::meshReplaced()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replaced_ = true;
+        changed_ = true;
+        // spans not taken yet were meant for the previous mesh
+        spans_.clear();
+    }
+    wake_.notify_all();
+}
+
+bool WarpUpdater::takeUpdate(std::vector<WarpVertexSpan> *spans)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (spans_.empty())
+        return false;
+
+    spans->swap(spans_);
+    spans_.clear();
+    return true;
+}
+
+void WarpUpdater::run()
+{
+    while (true) {
+        WarpGeometry configured;
+        WarpGeometry posed;
+        bool reset;
+        bool replaced;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return !running_ || changed_; });
+            if (!running_)
+                return;
+
+            configured = geometry_;
+            posed = geometry_;
+            posed.projector_position = position_;
+            posed.projector_rotation += glm::degrees(rotation_);
+            reset = reset_;
+            replaced = replaced_;
+            changed_ = false;
+            reset_ = false;
+            replaced_ = false;
+        }
+
+        if (reset) {
+            // the mesh on the GPU was generated at the configured pose
+            tangents_.clear();
+            configured_points_.clear();
+            if (!generator_.solve(configured, &tangents_))
+                continue;
+
+            WarpGenerator::textureCoordinates(configured, &uvs_);
+            configured_points_.resize(tangents_.size());
+            for (size_t i = 0; i < tangents_.size(); ++i)
+                configured_points_[i] = glm::vec2(configured.projector_position.x + (float) tangents_[i].x,
+                                                  configured.projector_position.y + (float) tangents_[i].y);
+            uploaded_points_ = configured_points_;
+        }
+        if (replaced)
+            uploaded_points_ = configured_points_;
+
+        if (!configured_points_.empty())
+            update(posed, configured);
+    }
+}
+
+void WarpUpdater::update(const WarpGeometry &posed, const WarpGeometry &configured)
+{
+    // a pose the projector can not reach keeps the last mesh
+    if (!generator_.solve(posed, &tangents_))
+        return;
+
+    // the center is a ring of its own here
+    std::vector<WarpVertexSpan> spans;
+    int points_per_ring = configured.points_per_ring;
+    bool open = false;
+    for (int ring = -1; ring < configured.rings; ++ring) {
+        size_t first = ring < 0 ? 0 : 1 + (size_t) ring * points_per_ring;
+        size_t last = 1 + (size_t) (ring + 1) * points_per_ring;
+
+        bool moved = false;
+        for (size_t i = first; i < last && !moved; ++i) {
+            glm::vec2 point(configured.projector_position.x + (float) tangents_[i].x,
+                            configured.projector_position.y + (float) tangents_[i].y);
+            moved = std::abs(point.x - uploaded_points_[i].x) > UPDATE_THRESHOLD ||
+                    std::abs(point.y - uploaded_points_[i].y) > UPDATE_THRESHOLD;
+        }
+        if (!moved) {
+            open = false;
+            continue;
+        }
+
+        // consecutive rings are written at once
+        if (!open)
+            spans.push_back({first, std::vector<WarpVertex>()});
+        open = true;
+        for (size_t i = first; i < last; ++i) {
+            uploaded_points_[i] = glm::vec2(configured.projector_position.x + (float) tangents_[i].x,
+                                            configured.projector_position.y + (float) tangents_[i].y);
+            spans.back().vertices.push_back({uploaded_points_[i].x, uploaded_points_[i].y, 0.0f, uvs_[i].x,
+                                             uvs_[i].y});
+        }
+    }
+    if (spans.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.insert(spans_.end(), std::make_move_iterator(spans.begin()), std::make_move_iterator(spans.end()));
+}
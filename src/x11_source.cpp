@@ -0,0 +1,151 @@
+#include "../inc/x11_source.h"
+
+#include <algorithm>
+#include <iostream>
+
+X11Source::X11Source(const FrameSourceSettings &settings)
+        : X11Source(settings, false)
+{
+}
+
+X11Source::X11Source(const FrameSourceSettings &settings, bool shared_memory)
+        : settings_(settings),
+          shared_memory_(shared_memory),
+          display_(nullptr),
+          capture_(nullptr),
+          damage_(nullptr),
+          dirty_()
+{
+}
+
+X11Source::~X11Source()
+{
+    close();
+}
+
+bool X11Source::open()
+{
+    close();
+
+    // Xlib connections must not be shared between threads, every source gets its own
+    display_ = XOpenDisplay(nullptr);
+    if (!display_) {
+        std::cout << "Capture: unable to open X display" << std::endl;
+        return false;
+    }
+
+    Window root_window = DefaultRootWindow(display_);
+    capture_ = new ScreenCapture(display_, root_window);
+    if (!capture_->open(settings_.x, settings_.y, settings_.width, settings_.height, shared_memory_)) {
+        close();
+        return false;
+    }
+
+    if (settings_.damage_threshold > 0.0f) {
+        damage_ = new DamageTracker(display_, root_window);
+        if (!damage_->open(settings_.x, settings_.y, settings_.width, settings_.height, settings_.damage_threshold)) {
+            delete damage_;
+            damage_ = nullptr;
+        }
+    }
+    return true;
+}
+
+void X11Source::close()
+{
+    delete damage_;
+    damage_ = nullptr;
+    delete capture_;
+    capture_ = nullptr;
+
+    if (display_) {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+    }
+}
+
+void X11Source::waitForFrame(double timeout_seconds)
+{
+    if (damage_)
+        damage_->waitForDamage(timeout_seconds);
+    else
+        FrameSource::waitForFrame(timeout_seconds);
+}
+
+const char *X11Source::name() const
+{
+    return "x11";
+}
+
+int X11Source::width() const
+{
+    return capture_ ? capture_->width() : 0;
+}
+
+int X11Source::height() const
+{
+    return capture_ ? capture_->height() : 0;
+}
+
+PixelFormat::Format X11Source::format() const
+{
+    return capture_ ? capture_->format() : PixelFormat::UNKNOWN;
+}
+
+FrameSource::Result X11Source::acquireFrame(SourceFrame *frame)
+{
+    if (!capture_)
+        return FAILED;
+
+    bool full = true;
+    dirty_.clear();
+
+    // nothing changed: skip the read back entirely
+    if (damage_ && !damage_->collect(&dirty_, &full))
+        return UNCHANGED;
+
+    XImage *image = full ? capture_->grab() : grabDirtyRows();
+    if (!image)
+        return FAILED;
+
+    frame->pixels = (const unsigned char *) image->data;
+    frame->width = image->width;
+    frame->height = image->height;
+    frame->stride = image->bytes_per_line;
+    frame->format = capture_->format();
+    frame->full = full;
+    frame->dirty = dirty_;
+    return ACQUIRED;
+}
+
+XImage *X11Source::grabDirtyRows()
+{
+    std::vector<Rect> rows(dirty_);
+    std::sort(rows.begin(), rows.end(), [](const Rect &a, const Rect &b) { return a.y < b.y; });
+
+    // read back merged full width bands, rectangles sharing rows are fetched once
+    XImage *image = nullptr;
+    int band_start = -1;
+    int band_end = -1;
+    for (const Rect &rect : rows) {
+        if (rect.y > band_end) {
+            if (band_end > band_start && !(image = capture_->grabRows(band_start, band_end - band_start)))
+                return nullptr;
+            band_start = rect.y;
+        }
+        band_end = std::max(band_end, rect.y + rect.height);
+    }
+    if (band_end > band_start && !(image = capture_->grabRows(band_start, band_end - band_start)))
+        return nullptr;
+    return image;
+}
+
+ShmSource::ShmSource(const FrameSourceSettings &settings)
+        : X11Source(settings, true)
+{
+}
+
+const char *ShmSource::name() const
+{
+    return "shm";
+}
@@ -0,0 +1,177 @@
+// Renders the warp on the CPU with the same mesh, texture coordinates and MVP as glwarp, e.g. to check calibrations
+// and outputs on build servers without a GPU. Frames come from a frame source and can be written as BMP files.
+// Usage: glwarp-cpu [-config <file>] [-mesh <file>] [-texcoords <file>] [-source synthetic|file]
+//                   [-source-file <file>] [-size <w>x<h>] [-frames <n>] [-threads <n>] [-output <prefix>] [-verify]
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../inc/cpu_warp.h"
+#include "../inc/frame_source.h"
+#include "../inc/input_parser.h"
+#include "../inc/json11.hpp"
+#include "../inc/mesh_loader.h"
+#include "../inc/pixel_format.h"
+#include "../inc/view_transform.h"
+
+static std::string option(const InputParser &input_parser, const std::string &name, const std::string &fallback)
+{
+    if (!input_parser.cmdOptionExists(name) || input_parser.getCmdOption(name).empty())
+        return fallback;
+    return input_parser.getCmdOption(name);
+}
+
+static bool loadConfig(const std::string &path, json11::Json *config)
+{
+    std::ifstream ifs(path);
+    if (!ifs.good()) {
+        std::cout << "Config: '" << path << "' not found!" << std::endl;
+        return false;
+    }
+
+    std::string str((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::string error;
+    *config = json11::Json::parse(str, error);
+    if (!error.empty()) {
+        std::cout << "Error loading json: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 32 bit BMP with bottom-up rows, the pixels are expected as BGRA
+static bool writeBMP(const std::string &path, const unsigned char *pixels, int width, int height)
+{
+    uint32_t image_size = (uint32_t) width * height * 4;
+    unsigned char header[54] = {'B', 'M'};
+    auto put32 = [&](int offset, uint32_t value) { std::memcpy(header + offset, &value, 4); };
+    put32(2, 54 + image_size);
+    put32(10, 54);
+    put32(14, 40);
+    put32(18, (uint32_t) width);
+    put32(22, (uint32_t) height);
+    header[26] = 1;
+    header[28] = 32;
+    put32(34, image_size);
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "unable to write '" << path << "'" << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+                   std::fwrite(pixels, 1, image_size, file) == image_size;
+    return std::fclose(file) == 0 && written;
+}
+
+int main(int argc, char *argv[])
+{
+    InputParser input_parser(argc, argv);
+    std::string config_path = option(input_parser, "-config", "default/model.json");
+    std::string mesh_path = option(input_parser, "-mesh", "default/default.mesh");
+    std::string tex_path = option(input_parser, "-texcoords", "default/default.tex");
+    std::string source_type = option(input_parser, "-source", "synthetic");
+    std::string output = option(input_parser, "-output", "");
+    int frames = std::atoi(option(input_parser, "-frames", "100").c_str());
+    int threads = std::atoi(option(input_parser, "-threads", "0").c_str());
+    int width = 1920;
+    int height = 1080;
+    std::sscanf(option(input_parser, "-size", "1920x1080").c_str(), "%dx%d", &width, &height);
+
+    json11::Json config;
+    WarpMeshData mesh;
+    if (!loadConfig(config_path, &config) || !MeshLoader::load(mesh_path, tex_path, false, &mesh))
+        return 1;
+
+    // the MVP glwarp starts with
+    glm::mat4 mvp = ViewTransform::mvp(ViewTransform::modelPosition(config), glm::vec3(0.0f, 0.0f, 0.0f));
+
+    CpuWarp warp(threads);
+    auto start = std::chrono::steady_clock::now();
+    if (!warp.bake(mesh, mvp, width, height))
+        return 1;
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "baked " << mesh.indices.size() / 3 << " triangles at " << width << "x" << height << " in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, " << warp.coverage() * 100.0
+              << "% covered" << std::endl;
+
+    FrameSourceSettings settings;
+    settings.x = 0;
+    settings.y = 0;
+    settings.width = config["capture"]["region"]["w"].int_value() > 0 ? config["capture"]["region"]["w"].int_value()
+                                                                      : 1080;
+    settings.height = config["capture"]["region"]["h"].int_value() > 0 ? config["capture"]["region"]["h"].int_value()
+                                                                       : 1080;
+    settings.damage_threshold = 0.0f;
+    settings.path = option(input_parser, "-source-file", "");
+    settings.realtime = false;
+
+    FrameSource *source = FrameSource::create(source_type, settings);
+    if (!source || !source->open()) {
+        delete source;
+        return 1;
+    }
+
+    std::vector<unsigned char> converted;
+    std::vector<unsigned char> warped((size_t) width * height * 4);
+    std::vector<unsigned char> reference;
+    std::vector<unsigned char> bitmap;
+    double warp_ms = 0.0;
+    int warped_frames = 0;
+    for (int i = 0; i < frames; ++i) {
+        SourceFrame frame;
+        if (source->acquire(&frame) != FrameSource::ACQUIRED)
+            break;
+
+        // 24 bit frames are expanded first, the warp samples 32 bit pixels
+        const unsigned char *pixels = frame.pixels;
+        int stride = frame.stride;
+        PixelFormat::Format format = PixelFormat::directFormat(frame.format);
+        if (!PixelFormat::isDirect(frame.format)) {
+            converted.resize((size_t) frame.width * frame.height * 4);
+            PixelFormat::convert(frame.pixels, frame.stride, frame.format, converted.data(), frame.width * 4, format,
+                                 frame.width, frame.height);
+            pixels = converted.data();
+            stride = frame.width * 4;
+        }
+
+        start = std::chrono::steady_clock::now();
+        warp.warp(pixels, frame.width, frame.height, stride, warped.data(), width * 4);
+        end = std::chrono::steady_clock::now();
+        warp_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        ++warped_frames;
+
+        if (i == 0 && input_parser.cmdOptionExists("-verify")) {
+            reference.resize(warped.size());
+            warp.warpScalar(pixels, frame.width, frame.height, stride, reference.data(), width * 4);
+            size_t differences = 0;
+            for (size_t k = 0; k < warped.size(); ++k)
+                differences += warped[k] != reference[k];
+            std::cout << "verify: " << differences << " bytes differ from the scalar reference" << std::endl;
+        }
+
+        if (!output.empty()) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "_%05d.bmp", i);
+            bitmap.resize(warped.size());
+            PixelFormat::convert(warped.data(), width * 4, format, bitmap.data(), width * 4, PixelFormat::BGRA, width,
+                                 height, true);
+            writeBMP(output + name, bitmap.data(), width, height);
+        }
+        source->release();
+    }
+    source->close();
+    delete source;
+
+    if (warped_frames > 0) {
+        std::cout << "warped " << warped_frames << " frames, " << warp_ms / warped_frames << " ms/frame ("
+                  << CpuWarp::kernelName() << ", " << warp.threadCount() << " threads)" << std::endl;
+    }
+    return 0;
+}
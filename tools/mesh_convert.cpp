@@ -0,0 +1,114 @@
+// Converts a text mesh and texture coordinate pair into a binary .wmesh file and verifies it by reading it back.
+// Usage: glwarp-meshconv <mesh file> <texcoord file> <output.wmesh> [-optimize] [-noindices]
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../inc/file_io.h"
+#include "../inc/mesh_builder.h"
+#include "../inc/mesh_file.h"
+#include "../inc/mesh_optimizer.h"
+
+static bool loadText(const char *path, std::vector<glm::vec3> *points, int *rings, int *points_per_ring)
+{
+    MeshLayout layout;
+    if (!FileIO::loadMesh(path, points, &layout))
+        return false;
+
+    *rings = layout.rings;
+    *points_per_ring = layout.points_per_ring;
+    return true;
+}
+
+static bool verify(const std::string &path, const std::vector<WarpVertex> &vertices,
+                   const std::vector<uint32_t> *indices)
+{
+    MeshFile file;
+    if (!file.open(path))
+        return false;
+
+    const MeshFileHeader &header = file.header();
+    if (header.vertex_count != vertices.size() ||
+        std::memcmp(file.vertices(), vertices.data(), vertices.size() * sizeof(WarpVertex)) != 0) {
+        std::cout << "verify: vertices differ" << std::endl;
+        return false;
+    }
+
+    if (!indices)
+        return header.index_count == 0;
+
+    if (header.index_count != indices->size()) {
+        std::cout << "verify: index count differs" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < indices->size(); ++i) {
+        uint32_t index = header.index_size == 2 ? ((const uint16_t *) file.indices())[i]
+                                                : ((const uint32_t *) file.indices())[i];
+        if (index != (*indices)[i]) {
+            std::cout << "verify: index " << i << " differs" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        std::cout << "Usage: glwarp-meshconv <mesh file> <texcoord file> <output.wmesh> [-optimize] [-noindices]"
+                  << std::endl;
+        return 1;
+    }
+
+    bool optimize = false;
+    bool with_indices = true;
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-optimize")
+            optimize = true;
+        else if (arg == "-noindices")
+            with_indices = false;
+    }
+
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> uvs;
+    int rings, points_per_ring, uv_rings, uv_points_per_ring;
+    if (!loadText(argv[1], &points, &rings, &points_per_ring) ||
+        !loadText(argv[2], &uvs, &uv_rings, &uv_points_per_ring))
+        return 1;
+
+    if (rings != uv_rings || points_per_ring != uv_points_per_ring) {
+        std::cout << "mesh and texture coordinates have a different layout" << std::endl;
+        return 1;
+    }
+
+    std::vector<WarpVertex> vertices;
+    std::vector<uint32_t> indices;
+    MeshBuilder builder(rings, points_per_ring);
+    if (!builder.build(points, uvs, &vertices, &indices, 0))
+        return 1;
+
+    uint32_t flags = 0;
+    if (optimize && with_indices) {
+        double before = MeshOptimizer::acmr(indices, (int) vertices.size(), MeshOptimizer::CACHE_SIZE);
+        indices = MeshOptimizer::optimizeVertexCache(indices, (int) vertices.size());
+        MeshOptimizer::optimizeVertexFetch(&vertices, &indices);
+        double after = MeshOptimizer::acmr(indices, (int) vertices.size(), MeshOptimizer::CACHE_SIZE);
+        std::cout << "vertex cache miss ratio " << before << " -> " << after << std::endl;
+        flags |= MeshFile::FLAG_OPTIMIZED;
+    }
+
+    const std::vector<uint32_t> *stored_indices = with_indices ? &indices : nullptr;
+    if (!MeshFile::write(argv[3], rings, points_per_ring, vertices, stored_indices, flags))
+        return 1;
+
+    if (!verify(argv[3], vertices, stored_indices)) {
+        std::cout << "round trip of '" << argv[3] << "' failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "wrote " << rings << " rings of " << points_per_ring << " (" << vertices.size() << " vertices, "
+              << (stored_indices ? indices.size() / 3 : 0) << " triangles) to '" << argv[3] << "'" << std::endl;
+    return 0;
+}
@@ -0,0 +1,348 @@
+// Renders the default model offscreen through EGL, e.g. on Mesa's llvmpipe on a CI machine without display or GPU.
+// Both warp modes and the lean mesh mode are compared against golden images and their frame rate is measured.
+// Usage: glwarp-render-check [-golden <dir>] [-update] [-size <w>x<h>] [-frames <n>] [-tolerance <n>]
+//                            [-fps-log <csv>] [-config <file>] [-mesh <file>] [-texcoords <file>]
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../inc/frame_source.h"
+#include "../inc/input_parser.h"
+#include "../inc/json11.hpp"
+#include "../inc/renderer.h"
+#include "../inc/texture_streamer.h"
+#include "../inc/view_transform.h"
+#include "../inc/warp_lut.h"
+#include "../inc/warp_mesh.h"
+
+// pixels may differ by a few steps between driver versions, only this fraction may exceed the tolerance
+static const double MAX_BAD_PIXELS = 0.001;
+
+struct RenderTarget {
+    GLuint framebuffer;
+    GLuint color;
+    GLuint depth;
+};
+
+static std::string option(const InputParser &input_parser, const std::string &name, const std::string &fallback)
+{
+    if (!input_parser.cmdOptionExists(name) || input_parser.getCmdOption(name).empty())
+        return fallback;
+    return input_parser.getCmdOption(name);
+}
+
+static bool createContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    // the surfaceless platform needs neither an X server nor a render node
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "EGL: no display" << std::endl;
+        return false;
+    }
+
+    const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint config_count = 0;
+    eglChooseConfig(display, config_attributes, &config, 1, &config_count);
+
+    // same version and profile as the window context of glwarp
+    const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                         EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                         EGL_NONE};
+    EGLContext context = eglCreateContext(display, config_count > 0 ? config : (EGLConfig) nullptr, EGL_NO_CONTEXT,
+                                          context_attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "EGL: unable to create a surfaceless OpenGL 3.3 core context" << std::endl;
+        return false;
+    }
+
+    // GLEW loads the GL entry points first and only then fails on the missing GLX display
+    glewExperimental = GL_TRUE;
+    GLenum result = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (result == GLEW_ERROR_NO_GLX_DISPLAY)
+        result = GLEW_OK;
+#endif
+    if (result != GLEW_OK) {
+        std::cout << "EGL: failed to initialize GLEW" << std::endl;
+        return false;
+    }
+
+    std::cout << "EGL " << major << "." << minor << ", " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+static RenderTarget createTarget(int width, int height, int samples, bool depth = true)
+{
+    RenderTarget target = {0, 0, 0};
+    glGenRenderbuffers(1, &target.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    if (depth) {
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    }
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+    if (depth)
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "framebuffer with " << samples << " samples is incomplete" << std::endl;
+    return target;
+}
+
+static void releaseTarget(RenderTarget *target)
+{
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteRenderbuffers(1, &target->color);
+    if (target->depth)
+        glDeleteRenderbuffers(1, &target->depth);
+}
+
+// top-down RGB rows
+static bool readPPM(const std::string &path, int *width, int *height, std::vector<unsigned char> *pixels)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    int max_value = 0;
+    bool valid = std::fscanf(file, "P6 %d %d %d", width, height, &max_value) == 3 && max_value == 255 &&
+                 std::fgetc(file) != EOF;
+    if (valid) {
+        pixels->resize((size_t) *width * *height * 3);
+        valid = std::fread(pixels->data(), 1, pixels->size(), file) == pixels->size();
+    }
+    std::fclose(file);
+    return valid;
+}
+
+static bool writePPM(const std::string &path, int width, int height, const std::vector<unsigned char> &pixels)
+{
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "unable to write '" << path << "'" << std::endl;
+        return false;
+    }
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+    bool written = std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    return std::fclose(file) == 0 && written;
+}
+
+// resolves the target and returns its pixels as top-down RGB rows
+static std::vector<unsigned char> readback(const RenderTarget &target, const RenderTarget &resolved, int width,
+                                           int height)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolved.framebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    std::vector<unsigned char> rgba((size_t) width * height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolved.framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    std::vector<unsigned char> rgb((size_t) width * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *src = rgba.data() + (size_t) (height - 1 - y) * width * 4;
+        unsigned char *dst = rgb.data() + (size_t) y * width * 3;
+        for (int x = 0; x < width; ++x)
+            std::memcpy(dst + x * 3, src + x * 4, 3);
+    }
+    return rgb;
+}
+
+static bool compare(const std::string &name, const std::string &golden_path, const std::vector<unsigned char> &image,
+                    int width, int height, int tolerance, bool update)
+{
+    if (update) {
+        if (!writePPM(golden_path, width, height, image))
+            return false;
+        std::cout << name << ": golden image '" << golden_path << "' updated" << std::endl;
+        return true;
+    }
+
+    int golden_width, golden_height;
+    std::vector<unsigned char> golden;
+    if (!readPPM(golden_path, &golden_width, &golden_height, &golden)) {
+        std::cout << name << ": FAILED, no golden image '" << golden_path << "', create it with -update" << std::endl;
+        return false;
+    }
+    if (golden_width != width || golden_height != height) {
+        std::cout << name << ": FAILED, golden image is " << golden_width << "x" << golden_height << std::endl;
+        return false;
+    }
+
+    size_t bad_pixels = 0;
+    int max_difference = 0;
+    for (size_t i = 0; i < image.size(); i += 3) {
+        int difference = 0;
+        for (int c = 0; c < 3; ++c)
+            difference = std::max(difference, std::abs((int) image[i + c] - (int) golden[i + c]));
+        max_difference = std::max(max_difference, difference);
+        bad_pixels += difference > tolerance;
+    }
+
+    double bad_fraction = (double) bad_pixels / (double) (width * height);
+    bool passed = bad_fraction <= MAX_BAD_PIXELS;
+    std::cout << name << ": " << (passed ? "passed" : "FAILED") << ", " << bad_pixels << " pixels differ by more than "
+              << tolerance << ", max difference " << max_difference << std::endl;
+
+    // keep the result next to the golden for inspection
+    if (!passed)
+        writePPM(name + ".actual.ppm", width, height, image);
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    InputParser input_parser(argc, argv);
+    std::string golden_dir = option(input_parser, "-golden", "golden");
+    std::string fps_log = option(input_parser, "-fps-log", "");
+    std::string config_path = option(input_parser, "-config", "default/model.json");
+    std::string mesh_path = option(input_parser, "-mesh", "default/default.mesh");
+    std::string tex_path = option(input_parser, "-texcoords", "default/default.tex");
+    bool update = input_parser.cmdOptionExists("-update");
+    int frames = std::atoi(option(input_parser, "-frames", "200").c_str());
+    int tolerance = std::atoi(option(input_parser, "-tolerance", "8").c_str());
+    int width = 960;
+    int height = 540;
+    std::sscanf(option(input_parser, "-size", "960x540").c_str(), "%dx%d", &width, &height);
+
+    std::ifstream config_stream(config_path);
+    std::string config_text((std::istreambuf_iterator<char>(config_stream)), std::istreambuf_iterator<char>());
+    std::string error;
+    json11::Json config = json11::Json::parse(config_text, error);
+    if (!error.empty()) {
+        std::cout << "Error loading json: " << error << std::endl;
+        return 1;
+    }
+
+    if (!createContext())
+        return 1;
+
+    GLuint vertex_array_id;
+    glGenVertexArrays(1, &vertex_array_id);
+    glBindVertexArray(vertex_array_id);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    Renderer renderer;
+    glm::mat4 mvp = ViewTransform::mvp(ViewTransform::modelPosition(config), glm::vec3(0.0f, 0.0f, 0.0f));
+
+    WarpMesh warp_mesh;
+    if (!renderer.init("shader/simple.vert", "shader/simple.frag") ||
+        !warp_mesh.load(mesh_path.c_str(), tex_path.c_str()))
+        return 1;
+
+    // the first frame of the synthetic source is the test pattern, uploaded through the capture path
+    FrameSourceSettings settings;
+    settings.x = 0;
+    settings.y = 0;
+    settings.width = 1024;
+    settings.height = 1024;
+    settings.damage_threshold = 0.0f;
+    settings.realtime = false;
+    FrameSource *source = FrameSource::create("synthetic", settings);
+    SourceFrame frame;
+    if (!source->open() || source->acquire(&frame) != FrameSource::ACQUIRED)
+        return 1;
+    TextureStreamer streamer;
+    streamer.init(frame.width, frame.height, TextureStreamer::SYNC);
+    streamer.upload(frame.pixels, frame.width, frame.height, frame.stride, frame.format);
+    source->release();
+    delete source;
+
+    WarpLut warp_lut;
+    RenderTarget resolved = createTarget(width, height, 0);
+    bool passed = true;
+    for (const std::string mode : {"mesh", "lut", "lean"}) {
+        // the window of the mesh mode is multisampled, the lookup mode runs without, the lean mode also without depth
+        bool lut = mode == "lut";
+        bool lean = mode == "lean";
+        if (lut && !warp_lut.init(width, height)) {
+            passed = false;
+            continue;
+        }
+        if (lean && !renderer.init("shader/edge_aa.vert", "shader/edge_aa.frag", false)) {
+            passed = false;
+            continue;
+        }
+        RenderTarget target = createTarget(width, height, lut || lean ? 0 : 4, !lean);
+
+        auto render = [&]() {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+            glViewport(0, 0, width, height);
+            if (lut) {
+                warp_lut.update(warp_mesh, mvp);
+                warp_lut.draw(streamer.texture());
+            } else {
+                renderer.beginFrame(true);
+                renderer.setView(mvp);
+                renderer.setTexture(streamer.texture());
+                renderer.draw(warp_mesh, false);
+            }
+        };
+
+        render();
+        std::vector<unsigned char> image = readback(target, resolved, width, height);
+        passed = compare(mode, golden_dir + "/" + mode + ".ppm", image, width, height, tolerance, update) && passed;
+
+        // the multisample resolve is part of presenting a frame
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            render();
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolved.framebuffer);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double fps = frames / seconds;
+        std::cout << mode << ": " << fps << " fps at " << width << "x" << height;
+        if (!lut)
+            std::cout << ", " << renderer.callCount() << " draw calls per frame";
+        std::cout << std::endl;
+
+        if (!fps_log.empty()) {
+            bool exists = std::ifstream(fps_log).good();
+            std::ofstream log(fps_log, std::ios::app);
+            if (!exists)
+                log << "mode,width,height,frames,fps,renderer" << std::endl;
+            log << mode << "," << width << "," << height << "," << frames << "," << fps << ",\""
+                << glGetString(GL_RENDERER) << "\"" << std::endl;
+        }
+        releaseTarget(&target);
+    }
+
+    releaseTarget(&resolved);
+    warp_lut.release();
+    warp_mesh.release();
+    streamer.release();
+    renderer.release();
+    glDeleteVertexArrays(1, &vertex_array_id);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+// Reference producer for the shared memory frame ring, publishes frames of a frame source for glwarp -source ring.
+// Frames are paced to the given rate, 0 publishes as fast as possible. Stops after -frames or on Ctrl+C.
+// Usage: glwarp-ring-producer [-name <shm name>] [-source synthetic|file] [-source-file <file>] [-size <w>x<h>]
+//                             [-fps <rate>] [-slots <n>] [-frames <n>]
+#include <iostream>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "../inc/frame_source.h"
+#include "../inc/input_parser.h"
+#include "../inc/shm_ring.h"
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void requestStop(int)
+{
+    stop_requested = 1;
+}
+
+static std::string option(const InputParser &input_parser, const std::string &name, const std::string &fallback)
+{
+    if (!input_parser.cmdOptionExists(name) || input_parser.getCmdOption(name).empty())
+        return fallback;
+    return input_parser.getCmdOption(name);
+}
+
+int main(int argc, char *argv[])
+{
+    InputParser input_parser(argc, argv);
+    std::string name = option(input_parser, "-name", "/glwarp");
+    std::string source_type = option(input_parser, "-source", "synthetic");
+    double fps = std::atof(option(input_parser, "-fps", "60").c_str());
+    int slots = std::atoi(option(input_parser, "-slots", "3").c_str());
+    long frames = std::atol(option(input_parser, "-frames", "0").c_str());
+
+    FrameSourceSettings settings;
+    settings.x = 0;
+    settings.y = 0;
+    settings.width = 1920;
+    settings.height = 1080;
+    std::sscanf(option(input_parser, "-size", "1920x1080").c_str(), "%dx%d", &settings.width, &settings.height);
+    settings.damage_threshold = 0.0f;
+    settings.path = option(input_parser, "-source-file", "");
+    // the producer paces the frames itself
+    settings.realtime = false;
+
+    FrameSource *source = FrameSource::create(source_type, settings);
+    if (!source || !source->open()) {
+        delete source;
+        return 1;
+    }
+
+    ShmRingProducer ring;
+    if (!ring.create(name, source->width(), source->height(), source->format(), slots)) {
+        source->close();
+        delete source;
+        return 1;
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(fps > 0.0 ? 1.0 / fps : 0.0));
+    auto start = std::chrono::steady_clock::now();
+    auto next_frame = start;
+    long published = 0;
+    while (!stop_requested && (frames <= 0 || published < frames)) {
+        SourceFrame frame;
+        if (source->acquire(&frame) != FrameSource::ACQUIRED) {
+            std::cout << "unable to acquire frame from " << source->name() << std::endl;
+            break;
+        }
+
+        unsigned char *slot = ring.beginFrame();
+        size_t row_size = (size_t) frame.width * PixelFormat::bytesPerPixel(frame.format);
+        for (int y = 0; y < frame.height; ++y)
+            std::memcpy(slot + (size_t) ring.stride() * y, frame.pixels + (size_t) frame.stride * y, row_size);
+        source->release();
+
+        auto now = std::chrono::steady_clock::now();
+        ring.publish((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+        ++published;
+
+        if (fps > 0.0) {
+            next_frame += interval;
+            if (next_frame < now)
+                next_frame = now;
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "published " << published << " frames in " << seconds << " s, " << published / seconds << " fps"
+              << std::endl;
+
+    ring.close();
+    source->close();
+    delete source;
+    return 0;
+}